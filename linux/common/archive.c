@@ -0,0 +1,1197 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <lzma.h>
+#include "archive.h"
+#include "http.h"
+#include "log.h"
+
+#define CHUNK_SIZE (256 * 1024)
+#define MAX_META_SIZE (1024 * 1024)
+
+#define ZIP_LOCAL_SIG      0x04034b50
+#define ZIP_CENTRAL_SIG    0x02014b50
+#define ZIP_DESCRIPTOR_SIG 0x08074b50
+#define ZIP_END_SIG        0x06054b50
+#define ZIP64_END_SIG      0x06064b50
+#define ZIP64_LOCATOR_SIG  0x07064b50
+
+enum stream_state {
+   TAR_HEADER,
+   TAR_DATA,
+   TAR_META,
+   TAR_SKIP,
+   ZIP_SIGNATURE,
+   ZIP_LOCAL,
+   ZIP_LOCAL_NAME,
+   ZIP_DATA,
+   ZIP_DESCRIPTOR,
+   ZIP_DESCRIPTOR_BODY,
+   ZIP_CENTRAL,
+   ZIP_CENTRAL_NAME,
+   STREAM_END
+};
+
+struct archive_stream {
+   enum archive_format format;
+   enum stream_state state;
+   char dest[1024];
+   int dest_fd;
+   int strip;
+   bool failed;
+
+   // Header bytes collected across writes.
+   unsigned char *hdr;
+   size_t hdr_len;
+   size_t hdr_cap;
+   size_t need;
+
+   // Compression layer of tar.gz and tar.xz
+   z_stream gz;
+   bool gz_ready;
+   lzma_stream xz;
+   bool xz_ready;
+   bool compressed_end;
+   unsigned char *chunk;
+
+   // Entry being written, fd is -1 for skipped entries. part is relative to dir.
+   int fd;
+   int dir;
+   char path[1200];
+   char part[1210];
+   uint64_t remaining;
+   uint64_t padding;
+   unsigned mode;
+
+   // tar GNU long names and pax paths
+   char meta_type;
+   char long_name[1024];
+   char long_link[1024];
+
+   // zip entry
+   z_stream zs;
+   bool zs_ready;
+   unsigned method;
+   unsigned flags;
+   bool zip64;
+   uint32_t crc;
+   uint32_t expected_crc;
+
+   uint64_t bytes_out;
+   unsigned files;
+
+   // Per-phase statistics, whatever is not decompression or writing is input.
+   uint64_t bytes_in;
+   uint64_t bytes_unpacked;
+   double started;
+   double decompress_time;
+   double write_time;
+};
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double rate(uint64_t bytes, double seconds)
+{
+   return seconds > 0 ? bytes / 1048576.0 / seconds : 0;
+}
+
+static uint16_t le16(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t le64(const unsigned char *p)
+{
+   return le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+
+static void fail(struct archive_stream *s, const char *what, const char *name)
+{
+   if (!s->failed) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Extraction failed: %s%s%s\n", what, name ? " " : "", name ? name : "");
+   }
+   s->failed = true;
+}
+
+/**
+ * Gather need bytes of a header into s->hdr. Returns true once complete.
+ */
+static bool collect(struct archive_stream *s, const unsigned char **buf, size_t *len)
+{
+   size_t n = s->need - s->hdr_len;
+
+   if (s->need > s->hdr_cap) {
+      unsigned char *hdr = realloc(s->hdr, s->need);
+
+      if (!hdr) {
+         fail(s, "out of memory", NULL);
+         return false;
+      }
+      s->hdr = hdr;
+      s->hdr_cap = s->need;
+   }
+
+   if (n > *len) {
+      n = *len;
+   }
+
+   memcpy(s->hdr + s->hdr_len, *buf, n);
+   s->hdr_len += n;
+   *buf += n;
+   *len -= n;
+   return s->hdr_len == s->need;
+}
+
+static void expect(struct archive_stream *s, enum stream_state state, size_t need)
+{
+   s->state = state;
+   s->need = need;
+   s->hdr_len = 0;
+}
+
+/**
+ * Turn an archive member name into a path below dest.
+ * Returns false for entries removed by strip and for unsafe names.
+ */
+static bool entry_path(struct archive_stream *s, const char *name, char *out, size_t size)
+{
+   const char *rel = name;
+   size_t len;
+
+   for (int i = 0; i < s->strip; i++) {
+      const char *slash = strchr(rel, '/');
+
+      if (!slash) {
+         return false;
+      }
+      rel = slash + 1;
+   }
+
+   while (*rel == '/' || (rel[0] == '.' && rel[1] == '/')) {
+      rel += (*rel == '/') ? 1 : 2;
+   }
+
+   if (*rel == '\0' || strcmp(rel, "..") == 0 || strncmp(rel, "../", 3) == 0 || strstr(rel, "/../")) {
+      return false;
+   }
+
+   if ((size_t)snprintf(out, size, "%s/%s", s->dest, rel) >= size) {
+      return false;
+   }
+
+   // Directory entries of zip end with a slash.
+   for (len = strlen(out); out[len - 1] == '/'; len--) {
+      out[len - 1] = '\0';
+   }
+   return true;
+}
+
+static bool make_parents(const char *path)
+{
+   char dir[1200];
+
+   snprintf(dir, sizeof(dir), "%s", path);
+
+   for (char *p = dir + 1; *p; p++) {
+      if (*p == '/') {
+         *p = '\0';
+         if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+            return false;
+         }
+         *p = '/';
+      }
+   }
+   return true;
+}
+
+/**
+ * Open the directory of an entry path, creating what is missing, and point
+ * leaf at its last component. Symlinks are not followed on the way, so an
+ * entry can't be written through a link an earlier entry made.
+ * Returns -1 on failure.
+ */
+static int open_parent(struct archive_stream *s, const char *path, const char **leaf)
+{
+   const char *rel = path + strlen(s->dest) + 1;
+   char walk[1200], *name = walk, *slash;
+   int dir = openat(s->dest_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+   snprintf(walk, sizeof(walk), "%s", rel);
+
+   while (dir >= 0 && (slash = strchr(name, '/'))) {
+      *slash = '\0';
+
+      if (strcmp(name, "..") == 0) {
+         close(dir);
+         return -1;
+      }
+
+      if (*name != '\0' && strcmp(name, ".") != 0) {
+         int next;
+
+         if (mkdirat(dir, name, 0755) != 0 && errno != EEXIST) {
+            close(dir);
+            return -1;
+         }
+         next = openat(dir, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+         close(dir);
+         dir = next;
+      }
+      name = slash + 1;
+   }
+
+   if (dir >= 0 && (*name == '\0' || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)) {
+      close(dir);
+      return -1;
+   }
+
+   *leaf = rel + (name - walk);
+   return dir;
+}
+
+/**
+ * Symlink targets must stay below dest: not absolute, and not climbing
+ * above it from the directory of the link.
+ */
+static bool link_inside(struct archive_stream *s, const char *path, const char *target)
+{
+   const char *rel = path + strlen(s->dest) + 1;
+   int dir_len = (int)(strrchr(path, '/') - rel), depth = 0;
+   char walk[2400], *save, *name;
+
+   if (target[0] == '/' || target[0] == '\0') {
+      return false;
+   }
+
+   snprintf(walk, sizeof(walk), "%.*s/%s", dir_len > 0 ? dir_len : 0, rel, target);
+
+   for (name = strtok_r(walk, "/", &save); name; name = strtok_r(NULL, "/", &save)) {
+      if (strcmp(name, "..") == 0) {
+         if (--depth < 0) {
+            return false;
+         }
+      } else if (strcmp(name, ".") != 0) {
+         depth++;
+      }
+   }
+   return true;
+}
+
+static void make_directory(struct archive_stream *s, const char *name)
+{
+   char path[1200];
+   const char *leaf;
+   int dir;
+
+   if (!entry_path(s, name, path, sizeof(path))) {
+      return;
+   }
+
+   if ((dir = open_parent(s, path, &leaf)) < 0 || (mkdirat(dir, leaf, 0755) != 0 && errno != EEXIST)) {
+      fail(s, "cannot create", path);
+   }
+
+   if (dir >= 0) {
+      close(dir);
+   }
+}
+
+static void make_symlink(struct archive_stream *s, const char *path, const char *target)
+{
+   const char *leaf;
+   int dir;
+
+   if (!link_inside(s, path, target)) {
+      fail(s, "link points outside the archive:", path);
+      return;
+   }
+
+   if ((dir = open_parent(s, path, &leaf)) < 0) {
+      fail(s, "cannot link", path);
+      return;
+   }
+
+   unlinkat(dir, leaf, 0);
+
+   if (symlinkat(target, dir, leaf) != 0) {
+      fail(s, "cannot link", path);
+   }
+   close(dir);
+}
+
+static void make_link(struct archive_stream *s, const char *name, const char *target, bool hard)
+{
+   char path[1200], target_path[1200];
+   const char *leaf, *target_leaf;
+   int dir, target_dir;
+
+   if (!entry_path(s, name, path, sizeof(path))) {
+      return;
+   }
+
+   if (!hard) {
+      make_symlink(s, path, target);
+      return;
+   }
+
+   if (!entry_path(s, target, target_path, sizeof(target_path)) || (target_dir = open_parent(s, target_path, &target_leaf)) < 0) {
+      fail(s, "cannot link", path);
+      return;
+   }
+
+   if ((dir = open_parent(s, path, &leaf)) < 0) {
+      fail(s, "cannot link", path);
+   } else {
+      unlinkat(dir, leaf, 0);
+
+      // linkat() without AT_SYMLINK_FOLLOW links a symlink itself, not what it points to.
+      if (linkat(target_dir, target_leaf, dir, leaf, 0) != 0) {
+         fail(s, "cannot link", path);
+      }
+      close(dir);
+   }
+   close(target_dir);
+}
+
+/**
+ * Entries are written to "<path>.part" and renamed into place once complete,
+ * so a running binary is never overwritten in place.
+ */
+static void entry_open(struct archive_stream *s, const char *name, unsigned mode)
+{
+   double start = now();
+   const char *leaf;
+
+   s->fd = -1;
+   s->mode = mode;
+
+   if (!entry_path(s, name, s->path, sizeof(s->path))) {
+      return;
+   }
+
+   if ((s->dir = open_parent(s, s->path, &leaf)) >= 0) {
+      snprintf(s->part, sizeof(s->part), "%s.part", leaf);
+      s->fd = openat(s->dir, s->part, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0644);
+   }
+
+   if (s->fd < 0) {
+      if (s->dir >= 0) {
+         close(s->dir);
+         s->dir = -1;
+      }
+      fail(s, "cannot create", s->path);
+   }
+   s->write_time += now() - start;
+}
+
+static void entry_write(struct archive_stream *s, const unsigned char *data, size_t len)
+{
+   double start;
+
+   s->crc = crc32(s->crc, data, len);
+
+   if (s->fd < 0) {
+      return;
+   }
+
+   start = now();
+   s->bytes_out += len;
+
+   while (len > 0) {
+      ssize_t n = write(s->fd, data, len);
+
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n <= 0) {
+         fail(s, "cannot write", s->path);
+         break;
+      }
+      data += n;
+      len -= n;
+   }
+   s->write_time += now() - start;
+}
+
+static void entry_close(struct archive_stream *s, bool ok)
+{
+   double start = now();
+
+   if (s->fd < 0) {
+      return;
+   }
+
+   if (ok) {
+      fchmod(s->fd, s->mode & 07777);
+   }
+
+   if (close(s->fd) != 0 || !ok || renameat(s->dir, s->part, s->dir, strrchr(s->path, '/') + 1) != 0) {
+      unlinkat(s->dir, s->part, 0);
+      if (ok) {
+         fail(s, "cannot write", s->path);
+      }
+   } else {
+      s->files++;
+   }
+
+   close(s->dir);
+   s->fd = -1;
+   s->dir = -1;
+   s->write_time += now() - start;
+}
+
+static uint64_t tar_number(const unsigned char *field, size_t len)
+{
+   uint64_t value = 0;
+
+   // GNU base-256 encoding for large values.
+   if (field[0] & 0x80) {
+      value = field[0] & 0x7F;
+      for (size_t i = 1; i < len; i++) {
+         value = (value << 8) | field[i];
+      }
+      return value;
+   }
+
+   for (size_t i = 0; i < len && field[i] != '\0'; i++) {
+      if (field[i] >= '0' && field[i] <= '7') {
+         value = (value << 3) | (field[i] - '0');
+      }
+   }
+   return value;
+}
+
+static bool tar_checksum_ok(const unsigned char *h)
+{
+   unsigned sum = 0;
+
+   for (int i = 0; i < 512; i++) {
+      sum += (i >= 148 && i < 156) ? ' ' : h[i];
+   }
+   return sum == tar_number(h + 148, 8);
+}
+
+static void tar_pax(struct archive_stream *s)
+{
+   const char *p = (const char *)s->hdr, *end = p + s->hdr_len;
+
+   // Records are "<length> <key>=<value>\n".
+   while (p < end) {
+      char *space;
+      long len = strtol(p, &space, 10);
+      const char *key, *eq;
+
+      if (len <= 0 || p + len > end || *space != ' ') {
+         return;
+      }
+
+      key = space + 1;
+      eq = memchr(key, '=', p + len - key);
+
+      if (eq) {
+         int value_len = (int)(p + len - 1 - (eq + 1));
+
+         if (eq - key == 4 && memcmp(key, "path", 4) == 0) {
+            snprintf(s->long_name, sizeof(s->long_name), "%.*s", value_len, eq + 1);
+         } else if (eq - key == 8 && memcmp(key, "linkpath", 8) == 0) {
+            snprintf(s->long_link, sizeof(s->long_link), "%.*s", value_len, eq + 1);
+         }
+      }
+      p += len;
+   }
+}
+
+static void tar_header(struct archive_stream *s)
+{
+   const unsigned char *h = s->hdr;
+   char name[1024], link_name[1024];
+   uint64_t size;
+   bool empty = true;
+   char type;
+
+   for (int i = 0; i < 512 && empty; i++) {
+      empty = h[i] == 0;
+   }
+
+   // The archive ends with zero blocks.
+   if (empty) {
+      s->state = STREAM_END;
+      return;
+   }
+
+   if (!tar_checksum_ok(h)) {
+      fail(s, "corrupt tar header", NULL);
+      return;
+   }
+
+   size = tar_number(h + 124, 12);
+   type = h[156];
+   s->padding = (512 - size % 512) % 512;
+
+   if (s->long_name[0] != '\0') {
+      snprintf(name, sizeof(name), "%s", s->long_name);
+   } else if (memcmp(h + 257, "ustar", 5) == 0 && h[345] != '\0') {
+      snprintf(name, sizeof(name), "%.155s/%.100s", (const char *)h + 345, (const char *)h);
+   } else {
+      snprintf(name, sizeof(name), "%.100s", (const char *)h);
+   }
+
+   if (s->long_link[0] != '\0') {
+      snprintf(link_name, sizeof(link_name), "%s", s->long_link);
+   } else {
+      snprintf(link_name, sizeof(link_name), "%.100s", (const char *)h + 157);
+   }
+
+   // GNU long names and pax headers describe the next entry.
+   if (type == 'L' || type == 'K' || type == 'x') {
+      if (size > MAX_META_SIZE) {
+         fail(s, "tar metadata too large", NULL);
+         return;
+      }
+      s->meta_type = type;
+      expect(s, TAR_META, size);
+      return;
+   }
+
+   s->long_name[0] = '\0';
+   s->long_link[0] = '\0';
+
+   switch (type) {
+      case '0':
+      case '\0':
+      case '7':
+         entry_open(s, name, (unsigned)tar_number(h + 100, 8));
+         s->remaining = size;
+         s->state = TAR_DATA;
+         if (size == 0) {
+            entry_close(s, true);
+            s->remaining = s->padding;
+            s->state = TAR_SKIP;
+         }
+         return;
+      case '5':
+         make_directory(s, name);
+         break;
+      case '2':
+         make_link(s, name, link_name, false);
+         break;
+      case '1':
+         make_link(s, name, link_name, true);
+         break;
+      default:
+         break;
+   }
+
+   s->remaining = size + s->padding;
+   s->state = TAR_SKIP;
+}
+
+static void tar_feed(struct archive_stream *s, const unsigned char *buf, size_t len)
+{
+   while (len > 0 && !s->failed) {
+      size_t n;
+
+      switch (s->state) {
+         case TAR_HEADER:
+            if (collect(s, &buf, &len)) {
+               tar_header(s);
+            }
+            break;
+         case TAR_META:
+            if (collect(s, &buf, &len)) {
+               if (s->meta_type == 'x') {
+                  tar_pax(s);
+               } else {
+                  char *value = s->meta_type == 'L' ? s->long_name : s->long_link;
+                  snprintf(value, sizeof(s->long_name), "%.*s", (int)s->hdr_len, (const char *)s->hdr);
+               }
+               s->remaining = s->padding;
+               s->state = TAR_SKIP;
+            }
+            break;
+         case TAR_DATA:
+            n = len < s->remaining ? len : (size_t)s->remaining;
+            entry_write(s, buf, n);
+            buf += n;
+            len -= n;
+            s->remaining -= n;
+            if (s->remaining == 0) {
+               entry_close(s, !s->failed);
+               s->remaining = s->padding;
+               s->state = TAR_SKIP;
+            }
+            break;
+         case TAR_SKIP:
+            n = len < s->remaining ? len : (size_t)s->remaining;
+            buf += n;
+            len -= n;
+            s->remaining -= n;
+            break;
+         default:
+            // Zero blocks and padding after the end of the archive.
+            return;
+      }
+
+      if (s->state == TAR_SKIP && s->remaining == 0) {
+         expect(s, TAR_HEADER, 512);
+      }
+   }
+}
+
+static void zip_local_header(struct archive_stream *s)
+{
+   const unsigned char *h = s->hdr;
+   uint16_t name_len = le16(h + 26), extra_len = le16(h + 28);
+   const unsigned char *extra = h + 30 + name_len;
+   uint64_t compressed = le32(h + 18);
+   char name[1024];
+
+   s->flags = le16(h + 6);
+   s->method = le16(h + 8);
+   s->expected_crc = le32(h + 14);
+   s->crc = crc32(0L, Z_NULL, 0);
+   s->zip64 = false;
+
+   snprintf(name, sizeof(name), "%.*s", (int)name_len, (const char *)h + 30);
+
+   // zip64 extra field: original size, then compressed size, when they overflowed.
+   for (size_t i = 0; i + 4 <= extra_len; ) {
+      uint16_t id = le16(extra + i), len = le16(extra + i + 2);
+
+      if (id == 0x0001 && i + 4 + len <= extra_len) {
+         size_t off = i + 4;
+
+         s->zip64 = true;
+         if (le32(h + 22) == 0xFFFFFFFF && len >= off - i - 4 + 8) {
+            off += 8;
+         }
+         if (compressed == 0xFFFFFFFF && off + 8 <= i + 4 + len) {
+            compressed = le64(extra + off);
+         }
+      }
+      i += 4 + len;
+   }
+
+   if (s->flags & 1) {
+      fail(s, "encrypted entry", name);
+      return;
+   }
+
+   if (s->method != 0 && s->method != 8) {
+      fail(s, "unsupported compression for", name);
+      return;
+   }
+
+   // Stored entries with a trailing descriptor have no length to stream by.
+   if (s->method == 0 && (s->flags & 8)) {
+      fail(s, "unstreamable entry", name);
+      return;
+   }
+
+   if (name_len > 0 && name[strlen(name) - 1] == '/') {
+      make_directory(s, name);
+      s->fd = -1;
+   } else {
+      entry_open(s, name, 0644);
+   }
+
+   if (s->method == 8) {
+      if (s->zs_ready) {
+         inflateReset(&s->zs);
+      } else if (inflateInit2(&s->zs, -MAX_WBITS) == Z_OK) {
+         s->zs_ready = true;
+      } else {
+         fail(s, "zlib init", NULL);
+         return;
+      }
+   }
+
+   s->remaining = compressed;
+   s->state = ZIP_DATA;
+}
+
+static void zip_entry_done(struct archive_stream *s)
+{
+   if (s->flags & 8) {
+      expect(s, ZIP_DESCRIPTOR, 4);
+      return;
+   }
+
+   if (s->crc != s->expected_crc) {
+      fail(s, "CRC mismatch in", s->path);
+   }
+
+   entry_close(s, !s->failed);
+   expect(s, ZIP_SIGNATURE, 4);
+}
+
+/**
+ * Unix permissions of zip entries only live in the central directory,
+ * which arrives last. Apply them to the files written earlier.
+ */
+static void zip_central_header(struct archive_stream *s)
+{
+   const unsigned char *h = s->hdr;
+   uint16_t name_len = le16(h + 28);
+   unsigned mode = le32(h + 38) >> 16;
+   char name[1024], path[1200];
+   const char *leaf;
+   int dir, fd;
+
+   if ((le16(h + 4) >> 8) != 3 || mode == 0) {
+      return;
+   }
+
+   snprintf(name, sizeof(name), "%.*s", (int)name_len, (const char *)h + 46);
+
+   if ((!S_ISLNK(mode) && !S_ISREG(mode)) || !entry_path(s, name, path, sizeof(path))
+         || (dir = open_parent(s, path, &leaf)) < 0) {
+      return;
+   }
+
+   fd = openat(dir, leaf, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+   close(dir);
+
+   if (fd < 0) {
+      return;
+   }
+
+   if (S_ISLNK(mode)) {
+      char target[1024];
+      ssize_t n = read(fd, target, sizeof(target) - 1);
+
+      close(fd);
+      if (n > 0) {
+         target[n] = '\0';
+         make_symlink(s, path, target);
+      }
+   } else {
+      fchmod(fd, mode & 07777);
+      close(fd);
+   }
+}
+
+static void zip_feed(struct archive_stream *s, const unsigned char *buf, size_t len)
+{
+   while (len > 0 && !s->failed) {
+      size_t n;
+      uint32_t sig;
+
+      switch (s->state) {
+         case ZIP_SIGNATURE:
+            if (!collect(s, &buf, &len)) {
+               break;
+            }
+            sig = le32(s->hdr);
+            if (sig == ZIP_LOCAL_SIG) {
+               s->state = ZIP_LOCAL;
+               s->need = 30;
+            } else if (sig == ZIP_CENTRAL_SIG) {
+               s->state = ZIP_CENTRAL;
+               s->need = 46;
+            } else if (sig == ZIP_END_SIG || sig == ZIP64_END_SIG || sig == ZIP64_LOCATOR_SIG) {
+               s->state = STREAM_END;
+            } else {
+               fail(s, "corrupt zip", NULL);
+            }
+            break;
+         case ZIP_LOCAL:
+            if (collect(s, &buf, &len)) {
+               s->state = ZIP_LOCAL_NAME;
+               s->need = 30 + le16(s->hdr + 26) + le16(s->hdr + 28);
+            }
+            break;
+         case ZIP_LOCAL_NAME:
+            if (collect(s, &buf, &len)) {
+               zip_local_header(s);
+               if (!s->failed && s->method == 0 && s->remaining == 0) {
+                  zip_entry_done(s);
+               }
+            }
+            break;
+         case ZIP_DATA:
+            if (s->method == 0) {
+               n = len < s->remaining ? len : (size_t)s->remaining;
+               entry_write(s, buf, n);
+               buf += n;
+               len -= n;
+               s->remaining -= n;
+               if (s->remaining == 0) {
+                  zip_entry_done(s);
+               }
+               break;
+            }
+
+            // Deflate streams carry their own end marker, the compressed size is not needed.
+            s->zs.next_in = (unsigned char *)buf;
+            s->zs.avail_in = len;
+
+            for (;;) {
+               double start = now();
+               int ret;
+
+               s->zs.next_out = s->chunk;
+               s->zs.avail_out = CHUNK_SIZE;
+               ret = inflate(&s->zs, Z_NO_FLUSH);
+               s->decompress_time += now() - start;
+               s->bytes_unpacked += CHUNK_SIZE - s->zs.avail_out;
+               entry_write(s, s->chunk, CHUNK_SIZE - s->zs.avail_out);
+
+               if (ret == Z_STREAM_END) {
+                  buf = s->zs.next_in;
+                  len = s->zs.avail_in;
+                  zip_entry_done(s);
+                  break;
+               }
+               if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                  fail(s, "corrupt deflate data in", s->path);
+                  break;
+               }
+               if (s->zs.avail_in == 0 && s->zs.avail_out != 0) {
+                  len = 0;
+                  break;
+               }
+            }
+            break;
+         case ZIP_DESCRIPTOR:
+            if (collect(s, &buf, &len)) {
+               // The descriptor signature is optional.
+               s->need = (le32(s->hdr) == ZIP_DESCRIPTOR_SIG ? 4 : 0) + (s->zip64 ? 20 : 12);
+               s->state = ZIP_DESCRIPTOR_BODY;
+            }
+            break;
+         case ZIP_DESCRIPTOR_BODY:
+            if (collect(s, &buf, &len)) {
+               const unsigned char *crc = s->hdr + (le32(s->hdr) == ZIP_DESCRIPTOR_SIG ? 4 : 0);
+
+               if (s->crc != le32(crc)) {
+                  fail(s, "CRC mismatch in", s->path);
+               }
+               entry_close(s, !s->failed);
+               expect(s, ZIP_SIGNATURE, 4);
+            }
+            break;
+         case ZIP_CENTRAL:
+            if (collect(s, &buf, &len)) {
+               s->state = ZIP_CENTRAL_NAME;
+               s->need = 46 + le16(s->hdr + 28) + le16(s->hdr + 30) + le16(s->hdr + 32);
+            }
+            break;
+         case ZIP_CENTRAL_NAME:
+            if (collect(s, &buf, &len)) {
+               zip_central_header(s);
+               expect(s, ZIP_SIGNATURE, 4);
+            }
+            break;
+         default:
+            return;
+      }
+   }
+}
+
+/**
+ * Inflate a chunk of tar.gz and pass the tar stream on.
+ */
+static void gz_feed(struct archive_stream *s, const unsigned char *buf, size_t len)
+{
+   s->gz.next_in = (unsigned char *)buf;
+   s->gz.avail_in = len;
+
+   while (!s->failed && s->gz.avail_in > 0) {
+      int ret;
+
+      if (s->compressed_end) {
+         // Another gzip member may follow, anything else is trailing padding.
+         if (*s->gz.next_in != 0x1f) {
+            break;
+         }
+         inflateReset(&s->gz);
+         s->compressed_end = false;
+      }
+
+      do {
+         double start = now();
+
+         s->gz.next_out = s->chunk;
+         s->gz.avail_out = CHUNK_SIZE;
+         ret = inflate(&s->gz, Z_NO_FLUSH);
+         s->decompress_time += now() - start;
+
+         if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            fail(s, "corrupt gzip data", NULL);
+            break;
+         }
+
+         s->bytes_unpacked += CHUNK_SIZE - s->gz.avail_out;
+         tar_feed(s, s->chunk, CHUNK_SIZE - s->gz.avail_out);
+      } while (!s->failed && ret != Z_STREAM_END && s->gz.avail_out == 0);
+
+      if (ret == Z_STREAM_END) {
+         s->compressed_end = true;
+      } else if (s->gz.avail_in == 0 || ret == Z_BUF_ERROR) {
+         break;
+      }
+   }
+}
+
+/**
+ * Decompress a chunk of tar.xz and pass the tar stream on. LZMA_FINISH
+ * without input checks that the xz stream is complete.
+ */
+static void xz_feed(struct archive_stream *s, const unsigned char *buf, size_t len, lzma_action action)
+{
+   s->xz.next_in = buf;
+   s->xz.avail_in = len;
+
+   while (!s->failed && !s->compressed_end) {
+      double start = now();
+      lzma_ret ret;
+
+      s->xz.next_out = s->chunk;
+      s->xz.avail_out = CHUNK_SIZE;
+      ret = lzma_code(&s->xz, action);
+      s->decompress_time += now() - start;
+
+      s->bytes_unpacked += CHUNK_SIZE - s->xz.avail_out;
+      tar_feed(s, s->chunk, CHUNK_SIZE - s->xz.avail_out);
+
+      if (ret == LZMA_STREAM_END) {
+         s->compressed_end = true;
+      } else if (ret == LZMA_BUF_ERROR && action == LZMA_FINISH) {
+         // Input ended mid-stream, reported as a truncated archive.
+         return;
+      } else if (ret != LZMA_OK) {
+         fail(s, "corrupt xz data", NULL);
+      } else if (s->xz.avail_in == 0 && s->xz.avail_out != 0) {
+         return;
+      }
+   }
+}
+
+struct archive_stream *archive_stream_open(enum archive_format format, const char *dest, int strip)
+{
+   struct archive_stream *s = calloc(1, sizeof(*s));
+   lzma_stream xz = LZMA_STREAM_INIT;
+
+   if (!s || !(s->chunk = malloc(CHUNK_SIZE))) {
+      free(s);
+      return NULL;
+   }
+
+   s->format = format;
+   s->strip = strip;
+   s->fd = -1;
+   s->dir = -1;
+   s->started = now();
+   s->xz = xz;
+   snprintf(s->dest, sizeof(s->dest), "%s/", dest);
+
+   // Everything below dest is created relative to it.
+   make_parents(s->dest);
+   s->dest[strlen(s->dest) - 1] = '\0';
+
+   if ((s->dest_fd = open(s->dest, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+      free(s->chunk);
+      free(s);
+      return NULL;
+   }
+
+   if (format == ARCHIVE_TAR_GZ) {
+      // 16 + MAX_WBITS: expect a gzip wrapper.
+      s->gz_ready = inflateInit2(&s->gz, 16 + MAX_WBITS) == Z_OK;
+   } else if (format == ARCHIVE_TAR_XZ) {
+      // Concatenated streams, like xz -d.
+      s->xz_ready = lzma_stream_decoder(&s->xz, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+   }
+
+   if (format != ARCHIVE_ZIP && !s->gz_ready && !s->xz_ready) {
+      close(s->dest_fd);
+      free(s->chunk);
+      free(s);
+      return NULL;
+   }
+
+   if (format == ARCHIVE_ZIP) {
+      expect(s, ZIP_SIGNATURE, 4);
+   } else {
+      expect(s, TAR_HEADER, 512);
+   }
+
+   return s;
+}
+
+bool archive_stream_write(struct archive_stream *s, const void *data, size_t len)
+{
+   if (s->failed) {
+      return false;
+   }
+
+   s->bytes_in += len;
+
+   switch (s->format) {
+      case ARCHIVE_ZIP:
+         zip_feed(s, data, len);
+         break;
+      case ARCHIVE_TAR_GZ:
+         gz_feed(s, data, len);
+         break;
+      case ARCHIVE_TAR_XZ:
+         xz_feed(s, data, len, LZMA_RUN);
+         break;
+   }
+
+   return !s->failed;
+}
+
+bool archive_stream_close(struct archive_stream *s)
+{
+   bool ok;
+
+   if (!s) {
+      return false;
+   }
+
+   if (s->format == ARCHIVE_TAR_XZ && !s->failed) {
+      xz_feed(s, NULL, 0, LZMA_FINISH);
+   }
+
+   if (s->format == ARCHIVE_ZIP) {
+      ok = s->state == STREAM_END;
+   } else {
+      // Some writers omit the closing zero blocks.
+      ok = s->compressed_end && (s->state == STREAM_END || (s->state == TAR_HEADER && s->hdr_len == 0));
+   }
+
+   if (!ok && !s->failed) {
+      fail(s, "archive is truncated", NULL);
+   }
+
+   entry_close(s, false);
+
+   if (s->gz_ready) {
+      inflateEnd(&s->gz);
+   }
+   if (s->xz_ready) {
+      lzma_end(&s->xz);
+   }
+   if (s->zs_ready) {
+      inflateEnd(&s->zs);
+   }
+
+   ok = !s->failed;
+
+   if (ok) {
+      double total = now() - s->started, input = total - s->decompress_time - s->write_time;
+
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Extracted %u files (%.1f MB) to %s in %.2fs\n",
+            s->files, s->bytes_out / 1048576.0, s->dest, total);
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Extraction phases: input %.1f MB in %.2fs (%.1f MB/s), "
+            "decompress %.2fs (%.1f MB/s), write %.2fs (%.1f MB/s)\n",
+            s->bytes_in / 1048576.0, input, rate(s->bytes_in, input),
+            s->decompress_time, rate(s->bytes_unpacked, s->decompress_time),
+            s->write_time, rate(s->bytes_out, s->write_time));
+   }
+
+   close(s->dest_fd);
+   free(s->hdr);
+   free(s->chunk);
+   free(s);
+   return ok;
+}
+
+static bool stream_sink(const void *data, size_t len, void *userdata)
+{
+   return archive_stream_write(userdata, data, len);
+}
+
+bool archive_download(const char *url, enum archive_format format, const char *dest, int strip)
+{
+   struct archive_stream *s = archive_stream_open(format, dest, strip);
+   bool ok;
+
+   if (!s) {
+      return false;
+   }
+
+   ok = http_stream(url, stream_sink, s);
+   return archive_stream_close(s) && ok;
+}
+
+bool archive_extract(const char *path, enum archive_format format, const char *dest, int strip)
+{
+   struct archive_stream *s;
+   unsigned char *buf;
+   bool ok = true;
+   ssize_t n;
+   int fd;
+
+   if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot open %s\n", path);
+      return false;
+   }
+
+   if (!(s = archive_stream_open(format, dest, strip)) || !(buf = malloc(CHUNK_SIZE))) {
+      archive_stream_close(s);
+      close(fd);
+      return false;
+   }
+
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+   while (ok && (n = read(fd, buf, CHUNK_SIZE)) != 0) {
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      ok = n > 0 && archive_stream_write(s, buf, n);
+   }
+
+   if (!ok && !s->failed) {
+      fail(s, "cannot read", path);
+   }
+
+   close(fd);
+   free(buf);
+   return archive_stream_close(s) && ok;
+}
+
+bool archive_format_from_name(const char *name, enum archive_format *format)
+{
+   size_t len = strlen(name);
+
+   if (len > 4 && strcasecmp(name + len - 4, ".zip") == 0) {
+      *format = ARCHIVE_ZIP;
+   } else if ((len > 7 && strcasecmp(name + len - 7, ".tar.gz") == 0) || (len > 4 && strcasecmp(name + len - 4, ".tgz") == 0)) {
+      *format = ARCHIVE_TAR_GZ;
+   } else if ((len > 7 && strcasecmp(name + len - 7, ".tar.xz") == 0) || (len > 4 && strcasecmp(name + len - 4, ".txz") == 0)) {
+      *format = ARCHIVE_TAR_XZ;
+   } else {
+      return false;
+   }
+   return true;
+}
+
+const char *archive_format_name(enum archive_format format)
+{
+   static const char *names[] = { "zip", "tar.gz", "tar.xz" };
+
+   return names[format];
+}
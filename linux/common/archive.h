@@ -0,0 +1,53 @@
+#ifndef LAUNCHER_ARCHIVE_H
+#define LAUNCHER_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum archive_format {
+   ARCHIVE_ZIP,
+   ARCHIVE_TAR_GZ,
+   ARCHIVE_TAR_XZ
+};
+
+struct archive_stream;
+
+/**
+ * Streaming extractor. Bytes of the archive are pushed in as they arrive
+ * and every entry is written straight to dest, without the archive ever
+ * touching the disk. The first strip path components of each entry are
+ * dropped, like tar --strip-components. Nothing lands outside dest: the
+ * extraction fails on symlinks that point outside it, and links made by
+ * earlier entries are never followed.
+ */
+struct archive_stream *archive_stream_open(enum archive_format format, const char *dest, int strip);
+bool archive_stream_write(struct archive_stream *stream, const void *data, size_t len);
+
+/**
+ * Finish extraction and free the stream. Returns false if the archive was
+ * truncated or any entry failed. Logs the time spent reading, decompressing
+ * and writing.
+ */
+bool archive_stream_close(struct archive_stream *stream);
+
+/**
+ * Download url and extract it on the fly into dest.
+ */
+bool archive_download(const char *url, enum archive_format format, const char *dest, int strip);
+
+/**
+ * Extract the archive at path into dest.
+ */
+bool archive_extract(const char *path, enum archive_format format, const char *dest, int strip);
+
+/**
+ * Guess the format from a file name: .zip, .tar.gz/.tgz or .tar.xz/.txz.
+ */
+bool archive_format_from_name(const char *name, enum archive_format *format);
+
+/**
+ * Short name of a format, "zip", "tar.gz" or "tar.xz".
+ */
+const char *archive_format_name(enum archive_format format);
+
+#endif
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include "cache.h"
+#include "log.h"
+
+// Loose metadata files used by the launchers before the shared cache.
+static const char *legacy_files[] = {
+   "0.Url.txt",
+   "1.CurrentVersion.txt",
+   "2.NewVersion.txt",
+   "3.ETag.txt",
+   "4.LastModified.txt",
+};
+
+int cache_lock(const char *path)
+{
+   char lock_path[1024];
+   int fd;
+
+   snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+   fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+   if (fd < 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot open %s\n", lock_path);
+      return -1;
+   }
+
+   if (flock(fd, LOCK_EX) != 0) {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+void cache_unlock(int fd)
+{
+   if (fd >= 0) {
+      flock(fd, LOCK_UN);
+      close(fd);
+   }
+}
+
+static void legacy_path(const char *path, const char *core, const char *file, char *out, size_t size)
+{
+   const char *slash = strrchr(path, '/');
+   int dir_len = slash ? (int)(slash - path) : 1;
+
+   snprintf(out, size, "%.*s/%s/%s", dir_len, slash ? path : ".", core, file);
+}
+
+static void load_legacy(const char *path, const char *core, struct cache_entry *entry)
+{
+   char file_path[1024];
+   FILE *file;
+
+   legacy_path(path, core, "1.CurrentVersion.txt", file_path, sizeof(file_path));
+
+   if ((file = fopen(file_path, "r")) != NULL) {
+      if (fgets(entry->current, sizeof(entry->current), file)) {
+         entry->current[strcspn(entry->current, "\n")] = '\0';
+      }
+      fclose(file);
+   }
+}
+
+static void remove_legacy(const char *path, const char *core)
+{
+   char file_path[1024];
+
+   for (size_t i = 0; i < sizeof(legacy_files) / sizeof(legacy_files[0]); i++) {
+      legacy_path(path, core, legacy_files[i], file_path, sizeof(file_path));
+      unlink(file_path);
+   }
+}
+
+static void set_field(struct cache_entry *entry, const char *key, const char *value)
+{
+   if (strcmp(key, "url") == 0) {
+      snprintf(entry->url, sizeof(entry->url), "%s", value);
+   } else if (strcmp(key, "current") == 0) {
+      snprintf(entry->current, sizeof(entry->current), "%s", value);
+   } else if (strcmp(key, "latest") == 0) {
+      snprintf(entry->latest, sizeof(entry->latest), "%s", value);
+   } else if (strcmp(key, "staged") == 0) {
+      snprintf(entry->staged, sizeof(entry->staged), "%s", value);
+   } else if (strcmp(key, "skip") == 0) {
+      snprintf(entry->skip, sizeof(entry->skip), "%s", value);
+   } else if (strcmp(key, "etag") == 0) {
+      snprintf(entry->etag, sizeof(entry->etag), "%s", value);
+   } else if (strcmp(key, "last_modified") == 0) {
+      snprintf(entry->last_modified, sizeof(entry->last_modified), "%s", value);
+   } else if (strcmp(key, "mirror_etag") == 0) {
+      snprintf(entry->mirror_etag, sizeof(entry->mirror_etag), "%s", value);
+   } else if (strcmp(key, "mirror_last_modified") == 0) {
+      snprintf(entry->mirror_last_modified, sizeof(entry->mirror_last_modified), "%s", value);
+   } else if (strcmp(key, "published") == 0) {
+      snprintf(entry->published, sizeof(entry->published), "%s", value);
+   } else if (strcmp(key, "digest") == 0) {
+      snprintf(entry->digest, sizeof(entry->digest), "%s", value);
+   } else if (strcmp(key, "zsync") == 0) {
+      snprintf(entry->zsync, sizeof(entry->zsync), "%s", value);
+   } else if (strcmp(key, "size") == 0) {
+      entry->size = strtoll(value, NULL, 10);
+   } else if (strcmp(key, "checked") == 0) {
+      entry->checked = strtoll(value, NULL, 10);
+   } else if (strcmp(key, "api_url") == 0) {
+      snprintf(entry->api_url, sizeof(entry->api_url), "%s", value);
+   } else if (strcmp(key, "download_url") == 0) {
+      snprintf(entry->download_url, sizeof(entry->download_url), "%s", value);
+   } else if (strcmp(key, "asset") == 0) {
+      entry->asset = atoi(value);
+   } else if (strcmp(key, "path") == 0) {
+      snprintf(entry->path, sizeof(entry->path), "%s", value);
+   } else if (strcmp(key, "file") == 0) {
+      snprintf(entry->file, sizeof(entry->file), "%s", value);
+   } else if (strcmp(key, "archive") == 0) {
+      snprintf(entry->archive, sizeof(entry->archive), "%s", value);
+   } else if (strcmp(key, "strip") == 0) {
+      entry->strip = atoi(value);
+   }
+}
+
+/**
+ * Returns the section name if line is a "[core]" header.
+ */
+static bool section_name(char *line, char **name)
+{
+   char *end;
+
+   if (line[0] != '[' || !(end = strchr(line, ']'))) {
+      return false;
+   }
+
+   *end = '\0';
+   *name = line + 1;
+   return true;
+}
+
+void cache_load(const char *path, const char *core, struct cache_entry *entry)
+{
+   char line[1200], *name;
+   bool found = false, in_section = false;
+   FILE *file = fopen(path, "r");
+
+   memset(entry, 0, sizeof(*entry));
+
+   while (file && fgets(line, sizeof(line), file)) {
+      char *sep;
+
+      line[strcspn(line, "\r\n")] = '\0';
+
+      if (section_name(line, &name)) {
+         in_section = strcmp(name, core) == 0;
+         found |= in_section;
+         continue;
+      }
+
+      if (in_section && (sep = strstr(line, " = ")) != NULL) {
+         *sep = '\0';
+         set_field(entry, line, sep + 3);
+      }
+   }
+
+   if (file) {
+      fclose(file);
+   }
+
+   if (!found) {
+      load_legacy(path, core, entry);
+   }
+}
+
+size_t cache_list(const char *path, char cores[][32], size_t max)
+{
+   char line[1200], *name;
+   size_t count = 0;
+   FILE *file = fopen(path, "r");
+
+   while (file && count < max && fgets(line, sizeof(line), file)) {
+      line[strcspn(line, "\r\n")] = '\0';
+
+      if (section_name(line, &name) && strlen(name) < sizeof(cores[0])) {
+         strcpy(cores[count++], name);
+      }
+   }
+
+   if (file) {
+      fclose(file);
+   }
+   return count;
+}
+
+bool cache_store(const char *path, const char *core, const struct cache_entry *entry)
+{
+   char tmp_path[1024], line[1200], *name;
+   bool in_section = false;
+   FILE *in = fopen(path, "r"), *out;
+
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+
+   if (!(out = fopen(tmp_path, "w"))) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot write %s\n", tmp_path);
+      if (in) {
+         fclose(in);
+      }
+      return false;
+   }
+
+   // Copy the sections of the other launchers untouched.
+   while (in && fgets(line, sizeof(line), in)) {
+      char copy[1200];
+
+      snprintf(copy, sizeof(copy), "%s", line);
+      copy[strcspn(copy, "\r\n")] = '\0';
+
+      if (section_name(copy, &name)) {
+         in_section = strcmp(name, core) == 0;
+      }
+
+      if (!in_section && line[0] != '\n') {
+         fputs(line, out);
+      }
+   }
+
+   if (in) {
+      fclose(in);
+   }
+
+   fprintf(out, "[%s]\n", core);
+   fprintf(out, "url = %s\n", entry->url);
+   fprintf(out, "current = %s\n", entry->current);
+   fprintf(out, "latest = %s\n", entry->latest);
+   fprintf(out, "staged = %s\n", entry->staged);
+   fprintf(out, "skip = %s\n", entry->skip);
+   fprintf(out, "etag = %s\n", entry->etag);
+   fprintf(out, "last_modified = %s\n", entry->last_modified);
+   fprintf(out, "mirror_etag = %s\n", entry->mirror_etag);
+   fprintf(out, "mirror_last_modified = %s\n", entry->mirror_last_modified);
+   fprintf(out, "published = %s\n", entry->published);
+   fprintf(out, "digest = %s\n", entry->digest);
+   fprintf(out, "zsync = %s\n", entry->zsync);
+   fprintf(out, "size = %lld\n", entry->size);
+   fprintf(out, "checked = %lld\n", entry->checked);
+   fprintf(out, "api_url = %s\n", entry->api_url);
+   fprintf(out, "download_url = %s\n", entry->download_url);
+   fprintf(out, "asset = %d\n", entry->asset);
+   fprintf(out, "path = %s\n", entry->path);
+   fprintf(out, "file = %s\n", entry->file);
+   fprintf(out, "archive = %s\n", entry->archive);
+   fprintf(out, "strip = %d\n", entry->strip);
+
+   if (fflush(out) != 0 || fsync(fileno(out)) != 0) {
+      fclose(out);
+      unlink(tmp_path);
+      return false;
+   }
+
+   if (fclose(out) != 0 || rename(tmp_path, path) != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot update %s\n", path);
+      unlink(tmp_path);
+      return false;
+   }
+
+   // The cache is authoritative now, drop the old loose files.
+   remove_legacy(path, core);
+   return true;
+}
@@ -0,0 +1,61 @@
+#ifndef LAUNCHER_CACHE_H
+#define LAUNCHER_CACHE_H
+
+#include <stdbool.h>
+
+/**
+ * Release metadata of one launcher, kept in the metadata cache shared
+ * by all launchers (system/launcher.cache), one section per core.
+ */
+struct cache_entry {
+   char url[1024];
+   char current[32];
+   char latest[32];
+   char staged[32];
+   char skip[32]; // release skipped after a rollback
+   char etag[128];
+   char last_modified[64];
+   // The release mirror is a server of its own, with validators of its own.
+   char mirror_etag[128];
+   char mirror_last_modified[64];
+   char published[32]; // published_at of latest
+   char digest[80];
+   char zsync[1024];
+   long long size;
+   long long checked;
+   // Where releases come from and how they are installed, for the batch updater.
+   char api_url[512];
+   char download_url[512];
+   int asset;
+   char path[1024];
+   char file[256];
+   char archive[16];
+   int strip;
+};
+
+/**
+ * Take the advisory lock of the cache. Blocks until other
+ * launchers are done with it. Returns the lock fd or -1.
+ */
+int cache_lock(const char *path);
+void cache_unlock(int fd);
+
+/**
+ * Load the section of core. A core without a section starts empty,
+ * except for the installed version found in its old 1.CurrentVersion.txt.
+ */
+void cache_load(const char *path, const char *core, struct cache_entry *entry);
+
+/**
+ * Replace the section of core, keeping the others. The file is rewritten
+ * atomically, so readers never see a partial cache. Call with the lock held.
+ */
+bool cache_store(const char *path, const char *core, const struct cache_entry *entry);
+
+/**
+ * Copy the names of up to max cores with a section in the cache to cores.
+ * Returns how many were found.
+ */
+size_t cache_list(const char *path, char cores[][32], size_t max);
+
+#endif
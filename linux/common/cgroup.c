@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include "cgroup.h"
+#include "log.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+// Where systemd mounts cgroup v2 next to the v1 controllers.
+#define CGROUP_HYBRID_ROOT "/sys/fs/cgroup/unified"
+
+// cpu.weight and io.weight go from 1 to 10000, 100 by default.
+#define FRONTEND_WEIGHT 25
+#define EMULATOR_WEIGHT 1000
+
+static bool cgroups_enabled = true;
+static bool checked, usable;
+static char base[1024];
+static pid_t emulator_pid = -1;
+static int emulator_fd = -1;
+
+void cgroup_set_enabled(bool enabled)
+{
+   cgroups_enabled = enabled;
+}
+
+static bool write_file(const char *dir, const char *name, const char *value)
+{
+   char path[1200];
+   FILE *file;
+   bool ok;
+
+   snprintf(path, sizeof(path), "%.1100s/%.64s", dir, name);
+
+   if (!(file = fopen(path, "w"))) {
+      return false;
+   }
+
+   ok = fputs(value, file) >= 0;
+   return fclose(file) == 0 && ok;
+}
+
+/**
+ * Value of key in a flat keyed file like cpu.stat, or of a single value
+ * file like memory.peak when key is NULL. -1 if missing.
+ */
+static long long read_value(const char *dir, const char *name, const char *key)
+{
+   char path[1200], line[256];
+   long long value = -1;
+   size_t len = key ? strlen(key) : 0;
+   FILE *file;
+
+   snprintf(path, sizeof(path), "%.1100s/%.64s", dir, name);
+
+   if (!(file = fopen(path, "r"))) {
+      return -1;
+   }
+
+   while (fgets(line, sizeof(line), file)) {
+      if (!key) {
+         value = strtoll(line, NULL, 10);
+         break;
+      }
+      if (strncmp(line, key, len) == 0 && line[len] == ' ') {
+         value = strtoll(line + len + 1, NULL, 10);
+         break;
+      }
+   }
+
+   fclose(file);
+   return value;
+}
+
+static bool has_controller(const char *dir, const char *name)
+{
+   char path[1200], line[256];
+   FILE *file;
+   bool found = false;
+
+   snprintf(path, sizeof(path), "%.1100s/cgroup.controllers", dir);
+
+   if (!(file = fopen(path, "r"))) {
+      return false;
+   }
+
+   if (fgets(line, sizeof(line), file)) {
+      for (char *word = strtok(line, " \n"); word && !found; word = strtok(NULL, " \n")) {
+         found = strcmp(word, name) == 0;
+      }
+   }
+
+   fclose(file);
+   return found;
+}
+
+/**
+ * systemd marks the cgroups it delegates with an extended attribute.
+ */
+static bool delegated(const char *dir)
+{
+   char value[8] = {0};
+
+   return getxattr(dir, "user.delegate", value, sizeof(value) - 1) > 0 ? value[0] == '1'
+         : getxattr(dir, "trusted.delegate", value, sizeof(value) - 1) > 0 && value[0] == '1';
+}
+
+static bool weigh(const char *dir, int weight)
+{
+   char value[32];
+
+   snprintf(value, sizeof(value), "%d", weight);
+   if (!write_file(dir, "cpu.weight", value)) {
+      return false;
+   }
+
+   // The io controller is not available with every I/O scheduler, the CPU weight alone still helps.
+   snprintf(value, sizeof(value), "default %d", weight);
+   write_file(dir, "io.weight", value);
+   return true;
+}
+
+/**
+ * Find the cgroup of the frontend and, if it is delegated, move the
+ * frontend into its frontend group and enable the controllers.
+ */
+static bool setup(void)
+{
+   char line[1024], frontend[1200], pid[16];
+   FILE *file = fopen("/proc/self/cgroup", "r");
+   char *path = NULL, *suffix;
+
+   if (!file) {
+      return false;
+   }
+
+   // The unified hierarchy is the "0::" line.
+   while (fgets(line, sizeof(line), file)) {
+      if (strncmp(line, "0::", 3) == 0) {
+         line[strcspn(line, "\n")] = '\0';
+         path = line + 3;
+         break;
+      }
+   }
+   fclose(file);
+
+   if (!path) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: No cgroup v2 hierarchy, resource groups are off.\n");
+      return false;
+   }
+
+   // Moved already by an earlier launch in this frontend.
+   if ((suffix = strrchr(path, '/')) != NULL && strcmp(suffix, "/frontend") == 0) {
+      *suffix = '\0';
+   }
+
+   snprintf(base, sizeof(base), "%s%.1000s",
+         access(CGROUP_ROOT "/cgroup.controllers", F_OK) == 0 ? CGROUP_ROOT : CGROUP_HYBRID_ROOT, path);
+
+   if (!delegated(base)) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: cgroup %s is not delegated, resource groups are off.\n", path);
+      return false;
+   }
+
+   // With the hybrid layout the controllers stay with cgroup v1.
+   if (!has_controller(base, "cpu")) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: No cpu controller in cgroup %s, resource groups are off.\n", path);
+      return false;
+   }
+
+   snprintf(frontend, sizeof(frontend), "%s/frontend", base);
+   snprintf(pid, sizeof(pid), "%d", (int)getpid());
+
+   // Processes may only live in leaf groups once controllers are enabled for the children.
+   if ((mkdir(frontend, 0755) != 0 && errno != EEXIST) || !write_file(frontend, "cgroup.procs", pid)) {
+      launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Cannot move the frontend into %s: %s\n", frontend, strerror(errno));
+      return false;
+   }
+
+   write_file(base, "cgroup.subtree_control", "+cpu");
+   write_file(base, "cgroup.subtree_control", "+io");
+   write_file(base, "cgroup.subtree_control", "+memory");
+
+   if (!weigh(frontend, FRONTEND_WEIGHT)) {
+      launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Cannot enable the cpu controller in %s: %s\n", base, strerror(errno));
+      return false;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Resource groups under %s\n", base);
+   return true;
+}
+
+int cgroup_spawn_begin(void)
+{
+   char emulator[1200];
+
+   if (!cgroups_enabled) {
+      return -1;
+   }
+
+   if (!checked) {
+      usable = setup();
+      checked = true;
+   }
+
+   if (!usable) {
+      return -1;
+   }
+
+   // A fresh group for every emulator, so its accounting covers only that run.
+   snprintf(emulator, sizeof(emulator), "%s/emulator", base);
+   rmdir(emulator);
+
+   if ((mkdir(emulator, 0755) != 0 && errno != EEXIST) || !weigh(emulator, EMULATOR_WEIGHT)) {
+      launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Cannot create %s: %s\n", emulator, strerror(errno));
+      return -1;
+   }
+
+   emulator_fd = open(emulator, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   return emulator_fd;
+}
+
+void cgroup_spawn_end(pid_t pid, bool placed)
+{
+   char emulator[1200], value[16];
+
+   if (emulator_fd >= 0) {
+      close(emulator_fd);
+      emulator_fd = -1;
+   }
+
+   if (!cgroups_enabled || !usable || pid <= 0) {
+      return;
+   }
+
+   snprintf(emulator, sizeof(emulator), "%s/emulator", base);
+   snprintf(value, sizeof(value), "%d", (int)pid);
+
+   // Before Linux 5.7 it is moved once it runs, whatever it started by then stays with the frontend.
+   if (placed || write_file(emulator, "cgroup.procs", value)) {
+      emulator_pid = pid;
+   }
+}
+
+void cgroup_reaped(pid_t pid)
+{
+   char emulator[1200];
+   long long usage, user, system, peak;
+
+   if (pid <= 0 || pid != emulator_pid) {
+      return;
+   }
+
+   emulator_pid = -1;
+   snprintf(emulator, sizeof(emulator), "%s/emulator", base);
+
+   usage = read_value(emulator, "cpu.stat", "usage_usec");
+   user = read_value(emulator, "cpu.stat", "user_usec");
+   system = read_value(emulator, "cpu.stat", "system_usec");
+   // memory.peak needs Linux 5.19.
+   peak = read_value(emulator, "memory.peak", NULL);
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Emulator group used %.1fs of CPU (%.1fs user, %.1fs system)\n",
+         usage / 1e6, user / 1e6, system / 1e6);
+   if (peak >= 0) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Emulator group memory peak: %.0f MB\n", peak / 1048576.0);
+   }
+
+   // Fails while something the emulator left behind still runs in it, the next launch tries again.
+   rmdir(emulator);
+}
@@ -0,0 +1,33 @@
+#ifndef LAUNCHER_CGROUP_H
+#define LAUNCHER_CGROUP_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * cgroup v2 resource groups.
+ *
+ * When the cgroup of the frontend is delegated to it, for example with
+ * systemd-run --user --scope -p Delegate=yes retroarch, the frontend moves
+ * into a "frontend" group with a low CPU and I/O weight, its background
+ * downloads and unpacking included, and each emulator runs in a fresh
+ * "emulator" group with a high weight. Without a delegated cgroup nothing
+ * changes.
+ */
+void cgroup_set_enabled(bool enabled);
+
+/**
+ * Called by the launcher around starting the emulator. begin returns the
+ * emulator group as a directory descriptor for clone3(CLONE_INTO_CGROUP),
+ * or -1. end moves the emulator there unless it was started in it already.
+ */
+int cgroup_spawn_begin(void);
+void cgroup_spawn_end(pid_t pid, bool placed);
+
+/**
+ * Called once the emulator pid was reaped. Logs the CPU time and peak
+ * memory of the emulator group and removes it.
+ */
+void cgroup_reaped(pid_t pid);
+
+#endif
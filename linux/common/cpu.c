@@ -0,0 +1,351 @@
+// For the cpu_set_t macros and sched_setaffinity().
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "cpu.h"
+#include "log.h"
+
+#define SYSFS "/sys/devices"
+// Cores within this share of the fastest one are performance cores, favored cores boost a bit higher.
+#define PERFORMANCE_SHARE 85
+
+enum policy {
+   POLICY_OFF,
+   POLICY_PERFORMANCE,
+   POLICY_CACHE,
+   POLICY_FAST
+};
+
+struct cpu_info {
+   int core;           // First thread of the core
+   int l3;             // First cpu sharing the L3 cache
+   long long l3_size;
+   long capacity;      // cpu_capacity or the maximum frequency
+};
+
+static enum policy placement;
+static bool use_smt = true;
+static int nice_boost;
+static int saved_nice;
+static bool boosted;
+
+static cpu_set_t original, emulator, frontend;
+static bool planned, moved;
+
+void cpu_set_placement(const char *policy, bool smt, int priority)
+{
+   placement = POLICY_OFF;
+
+   if (policy && strcmp(policy, "performance cores") == 0) {
+      placement = POLICY_PERFORMANCE;
+   } else if (policy && strcmp(policy, "cache die") == 0) {
+      placement = POLICY_CACHE;
+   } else if (policy && strcmp(policy, "fast die") == 0) {
+      placement = POLICY_FAST;
+   }
+
+   use_smt = smt;
+   nice_boost = priority > 0 ? priority : 0;
+   planned = false;
+}
+
+/**
+ * Read a sysfs file of one line into buf.
+ */
+static bool read_line(const char *path, char *buf, size_t size)
+{
+   FILE *file = fopen(path, "r");
+   bool ok;
+
+   if (!file) {
+      return false;
+   }
+
+   ok = fgets(buf, size, file) != NULL;
+   fclose(file);
+   return ok;
+}
+
+/**
+ * Parse a cpu list like "0-3,8-11" into set.
+ */
+static bool read_cpu_list(const char *path, cpu_set_t *set)
+{
+   char buf[1024], *p = buf;
+
+   CPU_ZERO(set);
+
+   if (!read_line(path, buf, sizeof(buf))) {
+      return false;
+   }
+
+   while (*p >= '0' && *p <= '9') {
+      long first = strtol(p, &p, 10), last = first;
+
+      if (*p == '-') {
+         last = strtol(p + 1, &p, 10);
+      }
+      for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+         CPU_SET(cpu, set);
+      }
+      if (*p == ',') {
+         p++;
+      }
+   }
+
+   return CPU_COUNT(set) > 0;
+}
+
+static int first_cpu(const cpu_set_t *set)
+{
+   for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, set)) {
+         return cpu;
+      }
+   }
+
+   return -1;
+}
+
+static long read_number(const char *path)
+{
+   char buf[64];
+
+   return read_line(path, buf, sizeof(buf)) ? strtol(buf, NULL, 10) : 0;
+}
+
+static void read_cpu(int cpu, struct cpu_info *info)
+{
+   char path[256], buf[64];
+   cpu_set_t set;
+
+   snprintf(path, sizeof(path), SYSFS "/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+   info->core = read_cpu_list(path, &set) ? first_cpu(&set) : cpu;
+
+   // index3 is the L3 cache on x86 and most ARM CPUs, without one every cpu is on its own die.
+   info->l3 = -1;
+   info->l3_size = 0;
+   snprintf(path, sizeof(path), SYSFS "/system/cpu/cpu%d/cache/index3/level", cpu);
+
+   if (read_number(path) == 3) {
+      snprintf(path, sizeof(path), SYSFS "/system/cpu/cpu%d/cache/index3/shared_cpu_list", cpu);
+      if (read_cpu_list(path, &set)) {
+         info->l3 = first_cpu(&set);
+      }
+
+      snprintf(path, sizeof(path), SYSFS "/system/cpu/cpu%d/cache/index3/size", cpu);
+      if (read_line(path, buf, sizeof(buf))) {
+         char *unit;
+
+         info->l3_size = strtoll(buf, &unit, 10) * (*unit == 'M' ? 1048576 : *unit == 'K' ? 1024 : 1);
+      }
+   }
+
+   snprintf(path, sizeof(path), SYSFS "/system/cpu/cpu%d/cpu_capacity", cpu);
+   if ((info->capacity = read_number(path)) <= 0) {
+      snprintf(path, sizeof(path), SYSFS "/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+      info->capacity = read_number(path);
+   }
+}
+
+static void format_cpus(const cpu_set_t *set, char *buf, size_t size)
+{
+   size_t len = 0;
+
+   buf[0] = '\0';
+
+   for (int cpu = 0; cpu < CPU_SETSIZE && len < size; cpu++) {
+      int last = cpu;
+
+      if (!CPU_ISSET(cpu, set)) {
+         continue;
+      }
+      while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set)) {
+         last++;
+      }
+
+      len += snprintf(buf + len, size - len, last > cpu ? "%s%d-%d" : "%s%d", len > 0 ? "," : "", cpu, last);
+      cpu = last;
+   }
+}
+
+/**
+ * Pick the cpus of the emulator among the ones the frontend may use.
+ */
+static void plan(void)
+{
+   static struct cpu_info cpus[CPU_SETSIZE];
+   cpu_set_t performance, hybrid;
+   long max_capacity = 0;
+   int best = -1;
+   char emulator_list[256], frontend_list[256];
+
+   CPU_ZERO(&emulator);
+   CPU_ZERO(&performance);
+   sched_getaffinity(0, sizeof(original), &original);
+   planned = true;
+
+   for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &original)) {
+         read_cpu(cpu, &cpus[cpu]);
+         max_capacity = cpus[cpu].capacity > max_capacity ? cpus[cpu].capacity : max_capacity;
+      }
+   }
+
+   // Hybrid Intel CPUs list their performance cores, elsewhere they are the fastest ones.
+   if (read_cpu_list(SYSFS "/cpu_core/cpus", &hybrid)) {
+      CPU_AND(&performance, &hybrid, &original);
+   }
+   if (CPU_COUNT(&performance) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+         if (CPU_ISSET(cpu, &original) && cpus[cpu].capacity * 100 >= max_capacity * PERFORMANCE_SHARE) {
+            CPU_SET(cpu, &performance);
+         }
+      }
+   }
+
+   // The die of the emulator: the largest L3 cache or the fastest cores, then the most cpus.
+   for (int cpu = 0; cpu < CPU_SETSIZE && placement != POLICY_PERFORMANCE; cpu++) {
+      int count = 0, best_count = 0;
+      bool better;
+
+      if (!CPU_ISSET(cpu, &performance) || cpus[cpu].l3 != cpu) {
+         continue;
+      }
+      if (best < 0) {
+         best = cpu;
+         continue;
+      }
+
+      for (int other = 0; other < CPU_SETSIZE; other++) {
+         count += CPU_ISSET(other, &performance) && cpus[other].l3 == cpu;
+         best_count += CPU_ISSET(other, &performance) && cpus[other].l3 == best;
+      }
+
+      if (placement == POLICY_CACHE && cpus[cpu].l3_size != cpus[best].l3_size) {
+         better = cpus[cpu].l3_size > cpus[best].l3_size;
+      } else if (placement == POLICY_FAST && cpus[cpu].capacity != cpus[best].capacity) {
+         better = cpus[cpu].capacity > cpus[best].capacity;
+      } else {
+         better = count > best_count;
+      }
+
+      if (better) {
+         best = cpu;
+      }
+   }
+
+   for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &performance) && (best < 0 || cpus[cpu].l3 == best)
+            && (use_smt || cpus[cpu].core == cpu || !CPU_ISSET(cpus[cpu].core, &original))) {
+         CPU_SET(cpu, &emulator);
+      }
+   }
+
+   if (CPU_COUNT(&emulator) == 0) {
+      emulator = original;
+   }
+
+   CPU_XOR(&frontend, &original, &emulator);
+
+   // With nothing left over the frontend shares the emulator's cpus.
+   if (CPU_COUNT(&frontend) == 0) {
+      frontend = original;
+   }
+
+   format_cpus(&emulator, emulator_list, sizeof(emulator_list));
+   format_cpus(&frontend, frontend_list, sizeof(frontend_list));
+   if (best >= 0 && cpus[best].l3_size > 0) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Emulator on cpus %s (%lld MB L3), frontend on cpus %s\n",
+            emulator_list, cpus[best].l3_size / 1048576, frontend_list);
+   } else {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Emulator on cpus %s, frontend on cpus %s\n", emulator_list, frontend_list);
+   }
+}
+
+/**
+ * Apply set to every thread of the frontend. Threads started later, like
+ * the ones of a background download, inherit it from their creator.
+ */
+static void move_frontend(const cpu_set_t *set)
+{
+   struct dirent *e;
+   DIR *d = opendir("/proc/self/task");
+
+   if (!d) {
+      sched_setaffinity(0, sizeof(*set), set);
+      return;
+   }
+
+   while ((e = readdir(d)) != NULL) {
+      if (e->d_name[0] != '.') {
+         sched_setaffinity((pid_t)strtol(e->d_name, NULL, 10), sizeof(*set), set);
+      }
+   }
+   closedir(d);
+}
+
+void cpu_spawn_begin(void)
+{
+   // Nice is per thread on Linux. The child inherits the one of this thread
+   // when it forks, and every thread of the emulator inherits it from there.
+   if (nice_boost > 0) {
+      int nice;
+
+      errno = 0;
+      saved_nice = getpriority(PRIO_PROCESS, 0);
+      nice = saved_nice - nice_boost;
+
+      if (errno == 0 && setpriority(PRIO_PROCESS, 0, nice < -20 ? -20 : nice) == 0) {
+         boosted = true;
+      } else {
+         launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Cannot raise the priority of the emulator: %s, see the nice limit (RLIMIT_NICE)\n",
+               strerror(errno));
+      }
+   }
+
+   if (placement == POLICY_OFF) {
+      return;
+   }
+
+   if (!planned) {
+      plan();
+   }
+
+   sched_setaffinity(0, sizeof(emulator), &emulator);
+}
+
+void cpu_spawn_end(pid_t pid)
+{
+   // Raising the nice value back needs no privilege.
+   if (boosted) {
+      setpriority(PRIO_PROCESS, 0, saved_nice);
+      boosted = false;
+   }
+
+   if (placement == POLICY_OFF) {
+      return;
+   }
+
+   if (pid <= 0) {
+      sched_setaffinity(0, sizeof(original), &original);
+      return;
+   }
+
+   move_frontend(&frontend);
+   moved = true;
+}
+
+void cpu_restore(void)
+{
+   if (moved) {
+      move_frontend(&original);
+      moved = false;
+   }
+}
@@ -0,0 +1,36 @@
+#ifndef LAUNCHER_CPU_H
+#define LAUNCHER_CPU_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * CPU placement of the emulator.
+ *
+ * policy is one of
+ * - "off": the emulator inherits the affinity of the frontend,
+ * - "performance cores": all cores but the efficiency cores of a hybrid CPU,
+ * - "cache die": the performance cores sharing the largest L3 cache, the
+ *   V-cache die of an X3D CPU,
+ * - "fast die": the performance cores sharing the L3 cache of the fastest
+ *   cores.
+ * Without smt only one thread of each core is used. The frontend and its
+ * background downloads move to the cores left over while the emulator
+ * runs. priority lowers the nice value of the emulator by that much.
+ */
+void cpu_set_placement(const char *policy, bool smt, int priority);
+
+/**
+ * Called by the launcher around starting the emulator. The child inherits
+ * the affinity and nice value of the calling thread, so it never runs on
+ * the wrong cores or with the wrong priority.
+ */
+void cpu_spawn_begin(void);
+void cpu_spawn_end(pid_t pid);
+
+/**
+ * Give the frontend all of its cores back.
+ */
+void cpu_restore(void);
+
+#endif
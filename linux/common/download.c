@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "download.h"
+#include "http.h"
+#include "sha256.h"
+#include "zsync.h"
+#include "mirror.h"
+#include "log.h"
+
+struct part_meta {
+   char path[1100]; // of the sidecar itself
+   char url[1024];
+   char id[32];
+   char digest[80];
+   long long size;
+   long long complete;
+};
+
+static bool meta_load(const char *path, struct part_meta *meta)
+{
+   char line[1200];
+   FILE *file = fopen(path, "r");
+
+   memset(meta, 0, sizeof(*meta));
+
+   if (!file) {
+      return false;
+   }
+
+   while (fgets(line, sizeof(line), file)) {
+      char *sep, *value;
+
+      line[strcspn(line, "\r\n")] = '\0';
+
+      if (!(sep = strstr(line, " = "))) {
+         continue;
+      }
+
+      *sep = '\0';
+      value = sep + 3;
+
+      if (strcmp(line, "url") == 0) {
+         snprintf(meta->url, sizeof(meta->url), "%s", value);
+      } else if (strcmp(line, "id") == 0) {
+         snprintf(meta->id, sizeof(meta->id), "%s", value);
+      } else if (strcmp(line, "digest") == 0) {
+         snprintf(meta->digest, sizeof(meta->digest), "%s", value);
+      } else if (strcmp(line, "size") == 0) {
+         meta->size = strtoll(value, NULL, 10);
+      } else if (strcmp(line, "complete") == 0) {
+         meta->complete = strtoll(value, NULL, 10);
+      }
+   }
+
+   fclose(file);
+   return true;
+}
+
+/**
+ * Rewrite the sidecar through a rename, so it is never seen half written.
+ */
+static bool meta_store(const struct part_meta *meta)
+{
+   char tmp_path[1120];
+   FILE *file;
+
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", meta->path);
+
+   if (!(file = fopen(tmp_path, "w"))) {
+      return false;
+   }
+
+   fprintf(file, "url = %s\n", meta->url);
+   fprintf(file, "id = %s\n", meta->id);
+   fprintf(file, "digest = %s\n", meta->digest);
+   fprintf(file, "size = %lld\n", meta->size);
+   fprintf(file, "complete = %lld\n", meta->complete);
+
+   if (fclose(file) != 0 || rename(tmp_path, meta->path) != 0) {
+      unlink(tmp_path);
+      return false;
+   }
+   return true;
+}
+
+static void save_progress(long long complete, void *userdata)
+{
+   struct part_meta *meta = userdata;
+
+   meta->complete = complete;
+   meta_store(meta);
+}
+
+static bool verify(const char *part, const struct cache_entry *entry)
+{
+   char hex[65];
+   struct stat st;
+
+   if (stat(part, &st) != 0) {
+      return false;
+   }
+
+   if (entry->size > 0 && st.st_size != entry->size) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Downloaded %lld bytes, expected %lld.\n",
+            (long long)st.st_size, entry->size);
+      return false;
+   }
+
+   // Older releases carry no digest, the size check is all there is.
+   if (strncmp(entry->digest, "sha256:", 7) != 0) {
+      return true;
+   }
+
+   if (!sha256_file(part, hex) || strcasecmp(hex, entry->digest + 7) != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Checksum mismatch, the download is corrupt.\n");
+      return false;
+   }
+   return true;
+}
+
+/**
+ * Continue the part file from url, unless it is complete already.
+ */
+static bool fetch(const char *url, const char *part, struct part_meta *meta)
+{
+   return (meta->size > 0 && meta->complete >= meta->size)
+         || http_download_from(url, part, meta->complete, save_progress, meta);
+}
+
+bool download_release(const struct cache_entry *entry, const char *path, const char *seed)
+{
+   struct part_meta meta, saved;
+   long long offset = 0;
+   char part[1100], mirror[1024], mirror_zsync[1024];
+   bool mirrored = mirror_url(entry->url, mirror, sizeof(mirror));
+   bool done = false;
+   struct stat st;
+
+   memset(&meta, 0, sizeof(meta));
+   snprintf(part, sizeof(part), "%s.part", path);
+   snprintf(meta.path, sizeof(meta.path), "%s.part.meta", path);
+   snprintf(meta.url, sizeof(meta.url), "%s", entry->url);
+   snprintf(meta.id, sizeof(meta.id), "%s", entry->latest);
+   snprintf(meta.digest, sizeof(meta.digest), "%s", entry->digest);
+   meta.size = entry->size;
+
+   // Only a transfer of the very same asset is resumed.
+   if (meta_load(meta.path, &saved) && stat(part, &st) == 0 && strcmp(saved.url, meta.url) == 0
+         && strcmp(saved.id, meta.id) == 0 && saved.size == meta.size && saved.complete > 0
+         && (meta.size <= 0 || saved.complete <= meta.size)) {
+      offset = saved.complete;
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Resuming download at %.1f of %.1f MB\n",
+            offset / 1048576.0, meta.size / 1048576.0);
+   } else {
+      unlink(part);
+   }
+
+   meta.complete = offset;
+   meta_store(&meta);
+
+   // Rebuild the release from the installed one, fetching only the changed blocks.
+   if (offset == 0 && entry->zsync[0] != '\0' && seed && access(seed, R_OK) == 0) {
+      done = (mirrored && mirror_url(entry->zsync, mirror_zsync, sizeof(mirror_zsync))
+                  && zsync_download(mirror_zsync, mirror, seed, part) && verify(part, entry))
+            || (zsync_download(entry->zsync, entry->url, seed, part) && verify(part, entry));
+
+      if (!done) {
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Delta update not possible, downloading the whole release.\n");
+         unlink(part);
+      }
+   }
+
+   // GitHub continues where the mirror stopped, or starts over if the mirror served another file.
+   if (!done && mirrored) {
+      bool fetched = fetch(mirror, part, &meta);
+
+      done = fetched && verify(part, entry);
+
+      if (!done) {
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Download from the mirror failed, continuing from GitHub.\n");
+
+         if (fetched) {
+            unlink(part);
+            meta.complete = 0;
+            meta_store(&meta);
+         }
+      }
+   }
+
+   // An interrupted download keeps its part file and sidecar for the next attempt.
+   if (!done && !fetch(entry->url, part, &meta)) {
+      return false;
+   }
+
+   if (!done && !verify(part, entry)) {
+      unlink(part);
+      unlink(meta.path);
+      return false;
+   }
+
+   if (rename(part, path) != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot write %s\n", path);
+      return false;
+   }
+
+   unlink(meta.path);
+   return true;
+}
@@ -0,0 +1,20 @@
+#ifndef LAUNCHER_DOWNLOAD_H
+#define LAUNCHER_DOWNLOAD_H
+
+#include <stdbool.h>
+#include "cache.h"
+
+/**
+ * Resumable download of the latest asset of entry to path.
+ *
+ * Data goes to path.part, next to a path.part.meta sidecar that records
+ * the URL, asset ID, expected size and digest. Calling it again for the
+ * same asset resumes an interrupted transfer where it stopped. path is
+ * only replaced once the size and SHA-256 digest of the part file match.
+ *
+ * If the release publishes a zsync file and seed, the installed release,
+ * exists, only the blocks that changed since seed are downloaded.
+ */
+bool download_release(const struct cache_entry *entry, const char *path, const char *seed);
+
+#endif
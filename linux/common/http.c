@@ -0,0 +1,806 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "http.h"
+#include "log.h"
+
+#define HTTP_USER_AGENT "libretro-core-launchers"
+#define PROGRESS_INTERVAL (4 * 1048576)
+#define STALL_SECONDS 30L
+
+static bool http_ready;
+static volatile int http_cancelled;
+static int http_connections = 1;
+static curl_off_t http_segment_size = 8 * 1048576;
+static CURLSH *http_share;
+static pthread_mutex_t http_share_locks[CURL_LOCK_DATA_LAST];
+
+bool http_init(void)
+{
+   if (!http_ready) {
+      http_ready = curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK;
+   }
+   return http_ready;
+}
+
+void http_deinit(void)
+{
+   if (http_share) {
+      curl_share_cleanup(http_share);
+      http_share = NULL;
+   }
+
+   if (http_ready) {
+      curl_global_cleanup();
+      http_ready = false;
+   }
+}
+
+void http_cancel(bool cancel)
+{
+   http_cancelled = cancel;
+}
+
+void http_set_connections(int connections, long long segment_size)
+{
+   http_connections = connections > 0 ? connections : 1;
+
+   if (segment_size > 0) {
+      http_segment_size = segment_size;
+   }
+}
+
+static void share_lock(CURL *curl, curl_lock_data data, curl_lock_access access, void *userdata)
+{
+   pthread_mutex_lock(&http_share_locks[data]);
+}
+
+static void share_unlock(CURL *curl, curl_lock_data data, void *userdata)
+{
+   pthread_mutex_unlock(&http_share_locks[data]);
+}
+
+bool http_share_connections(void)
+{
+   if (http_share) {
+      return true;
+   }
+
+   if (!http_init() || !(http_share = curl_share_init())) {
+      return false;
+   }
+
+   for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+      pthread_mutex_init(&http_share_locks[i], NULL);
+   }
+
+   curl_share_setopt(http_share, CURLSHOPT_LOCKFUNC, share_lock);
+   curl_share_setopt(http_share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+   curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+   curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+   curl_share_setopt(http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+   return true;
+}
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+   return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int check_cancel(void *userdata, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+   return http_cancelled;
+}
+
+static size_t write_memory(char *data, size_t size, size_t nmemb, void *userdata)
+{
+   struct http_response *resp = userdata;
+   size_t len = size * nmemb;
+   char *body = realloc(resp->body, resp->body_len + len + 1);
+
+   if (!body) {
+      return 0;
+   }
+
+   memcpy(body + resp->body_len, data, len);
+   resp->body = body;
+   resp->body_len += len;
+   resp->body[resp->body_len] = '\0';
+   return len;
+}
+
+/**
+ * Copy the value of header "name: value" into dst if line is that header.
+ */
+static void header_value(const char *line, size_t len, const char *name, char *dst, size_t size)
+{
+   size_t name_len = strlen(name);
+
+   if (len <= name_len || strncasecmp(line, name, name_len) != 0) {
+      return;
+   }
+
+   line += name_len;
+   len -= name_len;
+
+   while (len > 0 && (*line == ' ' || *line == '\t')) {
+      line++;
+      len--;
+   }
+   while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n' || line[len - 1] == ' ')) {
+      len--;
+   }
+
+   if (len < size) {
+      memcpy(dst, line, len);
+      dst[len] = '\0';
+   }
+}
+
+static size_t write_header(char *line, size_t size, size_t nmemb, void *userdata)
+{
+   struct http_response *resp = userdata;
+   size_t len = size * nmemb;
+
+   // Only keep the validators of the final response after redirects.
+   if (len > 5 && strncmp(line, "HTTP/", 5) == 0) {
+      resp->etag[0] = '\0';
+      resp->last_modified[0] = '\0';
+   }
+
+   header_value(line, len, "ETag:", resp->etag, sizeof(resp->etag));
+   header_value(line, len, "Last-Modified:", resp->last_modified, sizeof(resp->last_modified));
+   return len;
+}
+
+static CURL *http_handle(const char *url)
+{
+   CURL *curl = curl_easy_init();
+
+   if (!curl) {
+      return NULL;
+   }
+
+   curl_easy_setopt(curl, CURLOPT_URL, url);
+   curl_easy_setopt(curl, CURLOPT_USERAGENT, HTTP_USER_AGENT);
+   curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+   curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+   curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
+   // A connection that stalls fails like a dropped one, segments are retried.
+   curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+   curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, STALL_SECONDS);
+   curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, check_cancel);
+   curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+
+   if (http_share) {
+      curl_easy_setopt(curl, CURLOPT_SHARE, http_share);
+   }
+   return curl;
+}
+
+bool http_get(const char *url, const char *const *headers, struct http_response *resp)
+{
+   struct curl_slist *list = NULL;
+   CURLcode res;
+   CURL *curl;
+
+   memset(resp, 0, sizeof(*resp));
+
+   if (!http_init() || !(curl = http_handle(url))) {
+      return false;
+   }
+
+   for (size_t i = 0; headers && headers[i]; i++) {
+      list = curl_slist_append(list, headers[i]);
+   }
+
+   curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+   curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory);
+   curl_easy_setopt(curl, CURLOPT_WRITEDATA, resp);
+   curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header);
+   curl_easy_setopt(curl, CURLOPT_HEADERDATA, resp);
+
+   res = curl_easy_perform(curl);
+
+   if (res == CURLE_OK) {
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &resp->status);
+   } else {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: %s: %s\n", url, curl_easy_strerror(res));
+   }
+
+   curl_slist_free_all(list);
+   curl_easy_cleanup(curl);
+   return res == CURLE_OK;
+}
+
+void http_response_free(struct http_response *resp)
+{
+   free(resp->body);
+   memset(resp, 0, sizeof(*resp));
+}
+
+/**
+ * Run a download transfer and log its outcome and throughput.
+ */
+static bool perform_download(CURL *curl, const char *url, int fd)
+{
+   struct timespec start, end;
+   curl_off_t bytes = 0;
+   long status = 0;
+   CURLcode res;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+   res = curl_easy_perform(curl);
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+   curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+   curl_easy_cleanup(curl);
+
+   if (fd >= 0 && close(fd) != 0 && res == CURLE_OK) {
+      res = CURLE_WRITE_ERROR;
+   }
+
+   if (res != CURLE_OK) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Download of %s failed (%ld): %s\n",
+            url, status, curl_easy_strerror(res));
+      return false;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Downloaded %.1f MB in %.1fs\n",
+         bytes / 1048576.0, elapsed(&start, &end));
+   return true;
+}
+
+static size_t probe_header(char *line, size_t size, size_t nmemb, void *userdata)
+{
+   bool *ranges = userdata;
+   size_t len = size * nmemb;
+   char value[32] = {0};
+
+   if (len > 5 && strncmp(line, "HTTP/", 5) == 0) {
+      *ranges = false;
+   }
+
+   header_value(line, len, "Accept-Ranges:", value, sizeof(value));
+
+   if (strcasecmp(value, "bytes") == 0) {
+      *ranges = true;
+   }
+   return len;
+}
+
+/**
+ * HEAD url, following redirects. Returns the size of the final resource
+ * if its server accepts range requests, otherwise -1. The final URL is
+ * stored in effective so segments skip the redirect.
+ */
+static curl_off_t probe_ranges(const char *url, char *effective, size_t size)
+{
+   curl_off_t length = -1;
+   bool ranges = false;
+   char *final = NULL;
+   long status = 0;
+   CURL *curl = http_handle(url);
+
+   if (!curl) {
+      return -1;
+   }
+
+   curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+   curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, probe_header);
+   curl_easy_setopt(curl, CURLOPT_HEADERDATA, &ranges);
+
+   if (curl_easy_perform(curl) == CURLE_OK) {
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+      curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+      curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &final);
+      snprintf(effective, size, "%s", final ? final : url);
+   }
+
+   curl_easy_cleanup(curl);
+   return (status == 200 && ranges) ? length : -1;
+}
+
+enum ranged_result {
+   RANGED_OK,
+   RANGED_FAILED,
+   RANGED_UNSUPPORTED
+};
+
+struct ranged_download;
+
+struct segment {
+   struct ranged_download *dl;
+   CURL *curl;
+   curl_off_t start;
+   curl_off_t end;     // inclusive
+   curl_off_t offset;  // next byte to receive
+   unsigned char *buf; // data of streamed downloads until it is delivered
+   int attempts;
+   bool ignored;       // server answered with the whole file
+};
+
+struct ranged_download {
+   const char *path;  // file target, or NULL
+   http_sink_t sink;  // in-order stream target
+   void *userdata;
+   curl_off_t offset; // bytes of path that are already complete
+   http_progress_t progress;
+   void *progress_data;
+   int fd;
+   struct segment *segments;
+   size_t count;
+   size_t next;       // first segment not requested yet
+   size_t delivered;  // first segment not passed to sink yet
+};
+
+static size_t write_segment(char *data, size_t size, size_t nmemb, void *userdata)
+{
+   struct segment *seg = userdata;
+   size_t len = size * nmemb;
+   long status = 0;
+
+   curl_easy_getinfo(seg->curl, CURLINFO_RESPONSE_CODE, &status);
+
+   if (status != 206 || seg->offset + (curl_off_t)len > seg->end + 1) {
+      seg->ignored = true;
+      return 0;
+   }
+
+   if (seg->buf) {
+      memcpy(seg->buf + (seg->offset - seg->start), data, len);
+      seg->offset += len;
+      return len;
+   }
+
+   for (size_t done = 0; done < len; ) {
+      ssize_t n = pwrite(seg->dl->fd, data + done, len - done, seg->offset);
+
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n <= 0) {
+         return 0;
+      }
+      done += n;
+      seg->offset += n;
+   }
+   return len;
+}
+
+/**
+ * Point curl at the remaining bytes of seg and queue it on multi.
+ */
+static void segment_start(CURLM *multi, CURL *curl, struct segment *seg)
+{
+   char range[64];
+
+   seg->curl = curl;
+   snprintf(range, sizeof(range), "%" CURL_FORMAT_CURL_OFF_T "-%" CURL_FORMAT_CURL_OFF_T, seg->offset, seg->end);
+   curl_easy_setopt(curl, CURLOPT_RANGE, range);
+   curl_easy_setopt(curl, CURLOPT_WRITEDATA, seg);
+   curl_easy_setopt(curl, CURLOPT_PRIVATE, seg);
+   curl_multi_add_handle(multi, curl);
+}
+
+/**
+ * Next segment to request, or NULL. Streamed downloads buffer at most
+ * window segments ahead of the sink.
+ */
+static struct segment *segment_next(struct ranged_download *dl, size_t window)
+{
+   struct segment *seg;
+
+   if (dl->next >= dl->count || (dl->sink && dl->next >= dl->delivered + window)) {
+      return NULL;
+   }
+
+   seg = &dl->segments[dl->next];
+
+   if (dl->sink && !(seg->buf = malloc(seg->end - seg->start + 1))) {
+      return NULL;
+   }
+
+   dl->next++;
+   return seg;
+}
+
+/**
+ * Pass completed segments to the sink in file order. For files, report
+ * the complete prefix so an interrupted download can resume from it.
+ */
+static bool segment_deliver(struct ranged_download *dl)
+{
+   size_t delivered = dl->delivered;
+
+   while (dl->delivered < dl->next) {
+      struct segment *seg = &dl->segments[dl->delivered];
+
+      if (seg->offset <= seg->end) {
+         break;
+      }
+
+      if (dl->sink && !dl->sink(seg->buf, seg->end - seg->start + 1, dl->userdata)) {
+         return false;
+      }
+
+      free(seg->buf);
+      seg->buf = NULL;
+      dl->delivered++;
+   }
+
+   if (dl->progress && dl->delivered > delivered) {
+      dl->progress(dl->segments[dl->delivered - 1].end + 1, dl->progress_data);
+   }
+   return true;
+}
+
+/**
+ * Fetch the segments of dl as concurrent range requests over up to slots
+ * connections, either with pwrite() into dl->fd or buffered and handed to
+ * a sink in order. A failed segment is retried from the last byte it
+ * received.
+ */
+static enum ranged_result run_segments(const char *url, struct ranged_download *dl, size_t slots)
+{
+   enum ranged_result result = RANGED_OK;
+   size_t active = 0, idle = 0;
+   CURL **handles = calloc(slots, sizeof(*handles));
+   CURL **pool = calloc(slots, sizeof(*pool));
+   CURLM *multi = curl_multi_init();
+
+   if (!handles || !pool || !multi) {
+      result = RANGED_FAILED;
+   } else {
+      // One TCP connection per segment; HTTP/2 multiplexing would share a single one.
+      curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+   }
+
+   for (size_t i = 0; result == RANGED_OK && i < slots; i++) {
+      if (!(handles[i] = http_handle(url))) {
+         result = RANGED_FAILED;
+         break;
+      }
+      curl_easy_setopt(handles[i], CURLOPT_WRITEFUNCTION, write_segment);
+      pool[idle++] = handles[i];
+   }
+
+   while (result == RANGED_OK) {
+      struct segment *seg;
+      int running, queued;
+      CURLMsg *msg;
+
+      // Give idle connections the next segments.
+      while (idle > 0 && (seg = segment_next(dl, slots * 2))) {
+         segment_start(multi, pool[--idle], seg);
+         active++;
+      }
+
+      if (active == 0) {
+         if (dl->delivered < dl->count) {
+            result = RANGED_FAILED;
+         }
+         break;
+      }
+
+      curl_multi_poll(multi, NULL, 0, 1000, NULL);
+      curl_multi_perform(multi, &running);
+
+      while ((msg = curl_multi_info_read(multi, &queued))) {
+         CURL *curl = msg->easy_handle;
+
+         if (msg->msg != CURLMSG_DONE) {
+            continue;
+         }
+
+         curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&seg);
+         curl_multi_remove_handle(multi, curl);
+
+         if (seg->ignored) {
+            result = dl->delivered == 0 ? RANGED_UNSUPPORTED : RANGED_FAILED;
+         } else if (seg->offset <= seg->end && !http_cancelled && ++seg->attempts < 3) {
+            launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Retrying segment at %" CURL_FORMAT_CURL_OFF_T ": %s\n",
+                  seg->offset, curl_easy_strerror(msg->data.result));
+            segment_start(multi, curl, seg);
+            continue;
+         } else if (seg->offset <= seg->end && result == RANGED_OK) {
+            launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Download of %s failed: %s\n",
+                  url, curl_easy_strerror(msg->data.result));
+            result = RANGED_FAILED;
+         }
+
+         pool[idle++] = curl;
+         active--;
+      }
+
+      if (result == RANGED_OK && !segment_deliver(dl)) {
+         result = RANGED_FAILED;
+      }
+   }
+
+   for (size_t i = 0; handles && i < slots; i++) {
+      if (handles[i]) {
+         curl_multi_remove_handle(multi, handles[i]);
+         curl_easy_cleanup(handles[i]);
+      }
+   }
+
+   for (size_t i = 0; i < dl->count; i++) {
+      free(dl->segments[i].buf);
+      dl->segments[i].buf = NULL;
+   }
+
+   if (multi) {
+      curl_multi_cleanup(multi);
+   }
+   free(handles);
+   free(pool);
+   return result;
+}
+
+/**
+ * Split the rest of url past dl->offset into segments and fetch them.
+ * Files are preallocated so the segments don't fragment them.
+ */
+static enum ranged_result download_ranged(const char *url, curl_off_t length, struct ranged_download *dl, int *used)
+{
+   enum ranged_result result = RANGED_FAILED;
+   size_t slots = http_connections;
+   int err;
+
+   dl->count = (length - dl->offset + http_segment_size - 1) / http_segment_size;
+   slots = slots < dl->count ? slots : dl->count;
+   *used = (int)slots;
+
+   if (dl->path && (dl->fd = open(dl->path, O_WRONLY | O_CREAT | (dl->offset > 0 ? 0 : O_TRUNC) | O_CLOEXEC, 0644)) < 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot write %s\n", dl->path);
+      return RANGED_FAILED;
+   }
+
+   if (dl->path && (err = posix_fallocate(dl->fd, 0, length)) != 0 && ftruncate(dl->fd, length) != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot allocate %s: %s\n", dl->path, strerror(err));
+   } else if ((dl->segments = calloc(dl->count, sizeof(*dl->segments)))) {
+      for (size_t i = 0; i < dl->count; i++) {
+         dl->segments[i].dl = dl;
+         dl->segments[i].start = dl->segments[i].offset = dl->offset + i * http_segment_size;
+         dl->segments[i].end = (i + 1 == dl->count) ? length - 1 : dl->segments[i].start + http_segment_size - 1;
+      }
+      result = run_segments(url, dl, slots);
+      free(dl->segments);
+   }
+
+   if (dl->path && close(dl->fd) != 0 && result == RANGED_OK) {
+      result = RANGED_FAILED;
+   }
+   return result;
+}
+
+bool http_fetch_ranges(const char *url, const char *path, const long long *ranges, size_t count)
+{
+   struct ranged_download dl = { path, NULL, NULL, 0, NULL, NULL, -1 };
+   enum ranged_result result = RANGED_FAILED;
+   size_t slots = http_connections;
+   char effective[2048];
+
+   if (count == 0) {
+      return true;
+   }
+
+   // Resolve redirects once instead of per range.
+   if (!http_init() || probe_ranges(url, effective, sizeof(effective)) < 0) {
+      return false;
+   }
+
+   if ((dl.fd = open(path, O_WRONLY | O_CLOEXEC)) < 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot write %s\n", path);
+      return false;
+   }
+
+   if ((dl.segments = calloc(count, sizeof(*dl.segments)))) {
+      dl.count = count;
+
+      for (size_t i = 0; i < count; i++) {
+         dl.segments[i].dl = &dl;
+         dl.segments[i].start = dl.segments[i].offset = ranges[i * 2];
+         dl.segments[i].end = ranges[i * 2 + 1] - 1;
+      }
+      result = run_segments(effective, &dl, slots < count ? slots : count);
+      free(dl.segments);
+   }
+
+   if (close(dl.fd) != 0) {
+      result = RANGED_FAILED;
+   }
+   return result == RANGED_OK;
+}
+
+/**
+ * Segmented transfer of url into dl, if enabled and the server supports it.
+ */
+static enum ranged_result transfer_ranged(const char *url, struct ranged_download *dl)
+{
+   struct timespec start, end;
+   enum ranged_result result;
+   char effective[2048];
+   curl_off_t length;
+   int used = 0;
+
+   if (http_connections < 2) {
+      return RANGED_UNSUPPORTED;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   if ((length = probe_ranges(url, effective, sizeof(effective))) - dl->offset <= http_segment_size) {
+      return RANGED_UNSUPPORTED;
+   }
+
+   result = download_ranged(effective, length, dl, &used);
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   if (result == RANGED_OK) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Downloaded %.1f MB in %.1fs over %d connections\n",
+            (length - dl->offset) / 1048576.0, elapsed(&start, &end), used);
+   } else if (result == RANGED_UNSUPPORTED) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Server ignored range requests, using a single stream.\n");
+   }
+   return result;
+}
+
+struct file_context {
+   CURL *curl;
+   int fd;
+   curl_off_t pos;
+   curl_off_t reported;
+   bool checked;
+   http_progress_t progress;
+   void *progress_data;
+};
+
+static size_t write_file(char *data, size_t size, size_t nmemb, void *userdata)
+{
+   struct file_context *ctx = userdata;
+   size_t len = size * nmemb;
+
+   // A server that ignores the resume range sends the whole file again.
+   if (!ctx->checked) {
+      long status = 0;
+
+      curl_easy_getinfo(ctx->curl, CURLINFO_RESPONSE_CODE, &status);
+      ctx->checked = true;
+
+      if (status == 200 && ctx->pos > 0) {
+         ctx->pos = 0;
+         ctx->reported = 0;
+         if (ftruncate(ctx->fd, 0) != 0) {
+            return 0;
+         }
+         // Whoever tracks the progress, like the .part.meta sidecar, starts over too.
+         if (ctx->progress) {
+            ctx->progress(0, ctx->progress_data);
+         }
+      }
+   }
+
+   for (size_t done = 0; done < len; ) {
+      ssize_t n = pwrite(ctx->fd, data + done, len - done, ctx->pos);
+
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n <= 0) {
+         return 0;
+      }
+      done += n;
+      ctx->pos += n;
+   }
+
+   if (ctx->progress && ctx->pos - ctx->reported >= PROGRESS_INTERVAL) {
+      ctx->progress(ctx->pos, ctx->progress_data);
+      ctx->reported = ctx->pos;
+   }
+   return len;
+}
+
+bool http_download(const char *url, const char *path)
+{
+   return http_download_from(url, path, 0, NULL, NULL);
+}
+
+/**
+ * Large files are split into concurrent range requests when the server
+ * supports them, everything else is a single stream.
+ */
+bool http_download_from(const char *url, const char *path, long long offset,
+      http_progress_t progress, void *userdata)
+{
+   struct ranged_download dl = { path, NULL, NULL, offset, progress, userdata, -1 };
+   struct file_context ctx = { NULL, -1, offset, offset, offset == 0, progress, userdata };
+   enum ranged_result ranged;
+   char range[32];
+   bool ok;
+
+   if (!http_init()) {
+      return false;
+   }
+
+   if ((ranged = transfer_ranged(url, &dl)) != RANGED_UNSUPPORTED) {
+      return ranged == RANGED_OK;
+   }
+
+   if (!(ctx.curl = http_handle(url))) {
+      return false;
+   }
+
+   // Drop anything past the resume point, a ranged attempt may have preallocated the file.
+   if ((ctx.fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644)) < 0 || ftruncate(ctx.fd, offset) != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot write %s\n", path);
+      if (ctx.fd >= 0) {
+         close(ctx.fd);
+      }
+      curl_easy_cleanup(ctx.curl);
+      return false;
+   }
+
+   curl_easy_setopt(ctx.curl, CURLOPT_WRITEFUNCTION, write_file);
+   curl_easy_setopt(ctx.curl, CURLOPT_WRITEDATA, &ctx);
+   // A plain Range header, CURLOPT_RESUME_FROM fails outright when the server answers 200.
+   if (offset > 0) {
+      snprintf(range, sizeof(range), "%lld-", offset);
+      curl_easy_setopt(ctx.curl, CURLOPT_RANGE, range);
+   }
+
+   ok = perform_download(ctx.curl, url, ctx.fd);
+
+   if (progress && ctx.pos != ctx.reported) {
+      progress(ctx.pos, userdata);
+   }
+   return ok;
+}
+
+struct stream_context {
+   http_sink_t sink;
+   void *userdata;
+};
+
+static size_t write_stream(char *data, size_t size, size_t nmemb, void *userdata)
+{
+   struct stream_context *ctx = userdata;
+   size_t len = size * nmemb;
+
+   return ctx->sink(data, len, ctx->userdata) ? len : 0;
+}
+
+bool http_stream(const char *url, http_sink_t sink, void *userdata)
+{
+   struct ranged_download dl = { NULL, sink, userdata, 0, NULL, NULL, -1 };
+   struct stream_context ctx = { sink, userdata };
+   enum ranged_result ranged;
+   CURL *curl;
+
+   if (!http_init()) {
+      return false;
+   }
+
+   if ((ranged = transfer_ranged(url, &dl)) != RANGED_UNSUPPORTED) {
+      return ranged == RANGED_OK;
+   }
+
+   if (!(curl = http_handle(url))) {
+      return false;
+   }
+
+   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_stream);
+   curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ctx);
+   return perform_download(curl, url, -1);
+}
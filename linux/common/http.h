@@ -0,0 +1,82 @@
+#ifndef LAUNCHER_HTTP_H
+#define LAUNCHER_HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct http_response {
+   long status;
+   char *body;
+   size_t body_len;
+   char etag[128];
+   char last_modified[64];
+};
+
+/**
+ * Initialize/release libcurl. Call from retro_init()/retro_deinit().
+ */
+bool http_init(void);
+void http_deinit(void);
+
+/**
+ * Abort running transfers and fail new ones until called with false.
+ * Used to stop background work when the core is unloaded.
+ */
+void http_cancel(bool cancel);
+
+/**
+ * GET url into memory. headers is a NULL terminated list of extra
+ * request headers, or NULL. Returns false on transport errors,
+ * HTTP errors are reported through resp->status.
+ */
+bool http_get(const char *url, const char *const *headers, struct http_response *resp);
+void http_response_free(struct http_response *resp);
+
+/**
+ * Split downloads larger than segment_size bytes into range requests
+ * over up to connections parallel connections. 1 disables splitting.
+ */
+void http_set_connections(int connections, long long segment_size);
+
+/**
+ * Let every transfer from now on, on any thread, share one pool of
+ * connections, DNS results and TLS sessions. For callers that run many
+ * downloads from the same hosts at once.
+ */
+bool http_share_connections(void);
+
+/**
+ * Download url straight into path, following redirects.
+ */
+bool http_download(const char *url, const char *path);
+
+/**
+ * Called with the number of leading bytes of the target that are complete.
+ */
+typedef void (*http_progress_t)(long long complete, void *userdata);
+
+/**
+ * Like http_download(), but keep the first offset bytes of path and only
+ * fetch the rest. progress is called as the complete prefix grows, so an
+ * interrupted download can be resumed from there.
+ */
+bool http_download_from(const char *url, const char *path, long long offset,
+      http_progress_t progress, void *userdata);
+
+/**
+ * Download the byte ranges [ranges[2i], ranges[2i + 1]) of url into the
+ * same offsets of the existing file path, over parallel connections.
+ */
+bool http_fetch_ranges(const char *url, const char *path, const long long *ranges, size_t count);
+
+/**
+ * Receives downloaded data as it arrives, return false to abort.
+ */
+typedef bool (*http_sink_t)(const void *data, size_t len, void *userdata);
+
+/**
+ * Download url and hand every chunk to sink instead of a file.
+ */
+bool http_stream(const char *url, http_sink_t sink, void *userdata);
+
+#endif
@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "install.h"
+#include "download.h"
+#include "launch.h"
+#include "log.h"
+#include "mirror.h"
+#include "trace.h"
+
+#define MAX_VERSIONS 64
+
+struct version {
+   char id[32];
+   time_t mtime;
+   long long size;
+};
+
+static int keep_versions = 1;
+static long long disk_budget;
+
+void install_set_limits(int keep, long long budget)
+{
+   keep_versions = keep > 0 ? keep : 0;
+   disk_budget = budget > 0 ? budget : 0;
+}
+
+static void version_path(const char *dir, const char *id, const char *suffix, char *out, size_t size)
+{
+   // Asset IDs fit the 32 byte fields of the metadata cache.
+   snprintf(out, size, "%s/versions/%.31s%s", dir, id, suffix);
+}
+
+static bool ends_with(const char *name, const char *suffix)
+{
+   size_t len = strlen(name), suffix_len = strlen(suffix);
+
+   return len > suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+/**
+ * Disk usage of the tree at name, which is removed as well if remove is set.
+ */
+static long long walk_tree(int parent, const char *name, bool remove)
+{
+   long long total;
+   struct dirent *e;
+   struct stat st;
+   DIR *d;
+   int fd;
+
+   if (fstatat(parent, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+      return 0;
+   }
+
+   total = st.st_blocks * 512LL;
+
+   if (!S_ISDIR(st.st_mode)) {
+      if (remove) {
+         unlinkat(parent, name, 0);
+      }
+      return total;
+   }
+
+   if ((fd = openat(parent, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) < 0) {
+      return total;
+   }
+
+   if (!(d = fdopendir(fd))) {
+      close(fd);
+      return total;
+   }
+
+   while ((e = readdir(d)) != NULL) {
+      if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+         total += walk_tree(dirfd(d), e->d_name, remove);
+      }
+   }
+   closedir(d);
+
+   if (remove) {
+      unlinkat(parent, name, AT_REMOVEDIR);
+   }
+   return total;
+}
+
+static void remove_tree(const char *path)
+{
+   walk_tree(AT_FDCWD, path, true);
+}
+
+static bool make_dir(const char *path)
+{
+   return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+/**
+ * The finished versions in dir/versions, unsorted.
+ */
+static size_t list_versions(const char *dir, struct version *versions, size_t max)
+{
+   char path[1100], version[1200];
+   size_t count = 0;
+   struct dirent *e;
+   struct stat st;
+   DIR *d;
+
+   snprintf(path, sizeof(path), "%s/versions", dir);
+
+   if (!(d = opendir(path))) {
+      return 0;
+   }
+
+   while ((e = readdir(d)) != NULL && count < max) {
+      // Skips ".", ".." and the unfinished "<id>.tmp" folders.
+      if (strchr(e->d_name, '.') || strlen(e->d_name) >= sizeof(versions[0].id)) {
+         continue;
+      }
+
+      snprintf(version, sizeof(version), "%s/%s", path, e->d_name);
+
+      if (stat(version, &st) == 0 && S_ISDIR(st.st_mode)) {
+         snprintf(versions[count].id, sizeof(versions[0].id), "%s", e->d_name);
+         versions[count].mtime = st.st_mtime;
+         versions[count].size = 0;
+         count++;
+      }
+   }
+
+   closedir(d);
+   return count;
+}
+
+bool install_active(const char *dir, char *id, size_t size)
+{
+   char link[1100], target[256];
+   const char *name;
+   ssize_t len;
+
+   snprintf(link, sizeof(link), "%s/current", dir);
+
+   if ((len = readlink(link, target, sizeof(target) - 1)) <= 0) {
+      return false;
+   }
+
+   target[len] = '\0';
+   name = strrchr(target, '/') ? strrchr(target, '/') + 1 : target;
+
+   if (strlen(name) >= size) {
+      return false;
+   }
+
+   strcpy(id, name);
+   return true;
+}
+
+bool install_activate(const char *dir, const char *id)
+{
+   char version[1100], link[1100], tmp[1100], target[128];
+   struct stat st;
+
+   version_path(dir, id, "", version, sizeof(version));
+
+   if (stat(version, &st) != 0 || !S_ISDIR(st.st_mode)) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Version %s is not installed.\n", id);
+      return false;
+   }
+
+   snprintf(target, sizeof(target), "versions/%s", id);
+   snprintf(link, sizeof(link), "%s/current", dir);
+   snprintf(tmp, sizeof(tmp), "%s/current.%d.tmp", dir, (int)getpid());
+
+   // rename() replaces the old link in one step, there is no moment without one.
+   unlink(tmp);
+
+   if (symlink(target, tmp) != 0 || rename(tmp, link) != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot activate %s\n", version);
+      unlink(tmp);
+      return false;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Activated version %s\n", id);
+   return true;
+}
+
+bool install_previous(const char *dir, char *id, size_t size)
+{
+   struct version versions[MAX_VERSIONS];
+   size_t count = list_versions(dir, versions, MAX_VERSIONS);
+   const struct version *active = NULL, *previous = NULL;
+   char active_id[32];
+
+   if (!install_active(dir, active_id, sizeof(active_id))) {
+      return false;
+   }
+
+   for (size_t i = 0; i < count; i++) {
+      if (strcmp(versions[i].id, active_id) == 0) {
+         active = &versions[i];
+      }
+   }
+
+   for (size_t i = 0; active && i < count; i++) {
+      if (&versions[i] != active && versions[i].mtime <= active->mtime
+            && (!previous || versions[i].mtime > previous->mtime)) {
+         previous = &versions[i];
+      }
+   }
+
+   if (!previous) {
+      return false;
+   }
+
+   snprintf(id, size, "%s", previous->id);
+   return true;
+}
+
+bool install_download(const struct cache_entry *entry, const char *dir, const struct install_layout *layout)
+{
+   char versions[1100], version[1100], tmp[1100], target[1400], seed[1400], mirror[1024];
+   struct stat st;
+   int event;
+   bool ok;
+
+   version_path(dir, entry->latest, "", version, sizeof(version));
+
+   // Downloaded before, like the version left by a rollback.
+   if (stat(version, &st) == 0 && S_ISDIR(st.st_mode)) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Version %s is already downloaded.\n", entry->latest);
+      return true;
+   }
+
+   snprintf(versions, sizeof(versions), "%s/versions", dir);
+   version_path(dir, entry->latest, ".tmp", tmp, sizeof(tmp));
+   event = trace_begin("download");
+
+   if (layout->file) {
+      // The part file stays in the tmp folder, an interrupted download resumes there.
+      snprintf(target, sizeof(target), "%s/%s", tmp, layout->file);
+      snprintf(seed, sizeof(seed), "%s/current/%s", dir, layout->file);
+      ok = make_dir(dir) && make_dir(versions) && make_dir(tmp)
+            && download_release(entry, target, seed) && chmod(target, 0755) == 0;
+   } else {
+      bool done = false;
+
+      // Extraction can't be resumed, start over, from GitHub if the mirror fails.
+      remove_tree(tmp);
+      ok = make_dir(dir) && make_dir(versions) && make_dir(tmp);
+
+      if (ok && mirror_url(entry->url, mirror, sizeof(mirror))
+            && !(done = archive_download(mirror, layout->format, tmp, layout->strip))) {
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Download from the mirror failed, starting over from GitHub.\n");
+         remove_tree(tmp);
+         ok = make_dir(tmp);
+      }
+
+      ok = ok && (done || archive_download(entry->url, layout->format, tmp, layout->strip));
+
+      if (!ok) {
+         remove_tree(tmp);
+      }
+   }
+
+   trace_end(event);
+
+   // The modification time orders the versions for rollback and collection.
+   if (!ok || utimensat(AT_FDCWD, tmp, NULL, 0) != 0 || rename(tmp, version) != 0) {
+      return false;
+   }
+
+   install_collect(dir, entry);
+   return true;
+}
+
+bool install_adopt(const char *dir, const char *id, const struct install_layout *layout)
+{
+   char link[1100], old_path[1400], version[1100], path[1400];
+   struct stat st;
+
+   if (!layout->file || id[0] == '\0') {
+      return false;
+   }
+
+   snprintf(link, sizeof(link), "%s/current", dir);
+   snprintf(old_path, sizeof(old_path), "%s/%s", dir, layout->file);
+
+   if (lstat(link, &st) == 0 || stat(old_path, &st) != 0 || !S_ISREG(st.st_mode)) {
+      return false;
+   }
+
+   snprintf(path, sizeof(path), "%s/versions", dir);
+   version_path(dir, id, "", version, sizeof(version));
+   make_dir(path);
+   make_dir(version);
+   snprintf(path, sizeof(path), "%s/%s", version, layout->file);
+
+   if (rename(old_path, path) != 0) {
+      return false;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Moved %s to %s\n", old_path, version);
+   return install_activate(dir, id);
+}
+
+/**
+ * Files left in dir by the launchers before versioned installs:
+ * tmp_dir of the shell extractor, staged releases and their part files.
+ */
+static void remove_leftovers(const char *dir)
+{
+   char path[1400];
+   struct dirent *e;
+   DIR *d = opendir(dir);
+
+   while (d && (e = readdir(d)) != NULL) {
+      if (strcmp(e->d_name, "tmp_dir") == 0 || ends_with(e->d_name, ".staged")
+            || ends_with(e->d_name, ".part") || ends_with(e->d_name, ".part.meta")) {
+         snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Removing leftover %s\n", path);
+         remove_tree(path);
+      }
+   }
+
+   if (d) {
+      closedir(d);
+   }
+}
+
+/**
+ * Unfinished downloads of releases other than the latest.
+ */
+static void remove_stale_downloads(const char *dir, const struct cache_entry *entry)
+{
+   char path[1100], tmp[1400], latest[64];
+   struct dirent *e;
+   DIR *d;
+
+   snprintf(path, sizeof(path), "%s/versions", dir);
+   snprintf(latest, sizeof(latest), "%s.tmp", entry->latest);
+
+   if (!(d = opendir(path))) {
+      return;
+   }
+
+   while ((e = readdir(d)) != NULL) {
+      if (ends_with(e->d_name, ".tmp") && strcmp(e->d_name, latest) != 0) {
+         snprintf(tmp, sizeof(tmp), "%s/%s", path, e->d_name);
+         remove_tree(tmp);
+      }
+   }
+   closedir(d);
+}
+
+static bool is_protected(const struct version *v, const char *active, const struct cache_entry *entry)
+{
+   return strcmp(v->id, active) == 0 || strcmp(v->id, entry->current) == 0
+         || strcmp(v->id, entry->staged) == 0 || strcmp(v->id, entry->latest) == 0;
+}
+
+static int newest_first(const void *a, const void *b)
+{
+   const struct version *x = a, *y = b;
+
+   return (x->mtime < y->mtime) - (x->mtime > y->mtime);
+}
+
+static void remove_version(const char *dir, const struct version *v)
+{
+   char path[1100];
+
+   version_path(dir, v->id, "", path, sizeof(path));
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Removing old version %s (%.1f MB)\n", v->id, v->size / 1048576.0);
+   remove_tree(path);
+}
+
+void install_collect(const char *dir, const struct cache_entry *entry)
+{
+   struct version versions[MAX_VERSIONS];
+   size_t count = list_versions(dir, versions, MAX_VERSIONS);
+   long long total = 0;
+   char active[32] = {0}, path[1100];
+   int kept = 0;
+
+   remove_leftovers(dir);
+   remove_stale_downloads(dir, entry);
+   install_active(dir, active, sizeof(active));
+   qsort(versions, count, sizeof(versions[0]), newest_first);
+
+   for (size_t i = 0; i < count; i++) {
+      version_path(dir, versions[i].id, "", path, sizeof(path));
+      versions[i].size = walk_tree(AT_FDCWD, path, false);
+   }
+
+   // Keep the newest previous versions, then drop the oldest of them until the budget fits.
+   for (size_t i = 0; i < count; i++) {
+      if (is_protected(&versions[i], active, entry)) {
+         total += versions[i].size;
+      } else if (kept < keep_versions) {
+         total += versions[i].size;
+         kept++;
+      } else {
+         remove_version(dir, &versions[i]);
+         versions[i].size = -1;
+      }
+   }
+
+   for (size_t i = count; disk_budget > 0 && total > disk_budget && i-- > 0; ) {
+      if (versions[i].size >= 0 && !is_protected(&versions[i], active, entry)) {
+         remove_version(dir, &versions[i]);
+         total -= versions[i].size;
+      }
+   }
+}
+
+bool install_appdir(const char *appimage, bool enabled, char *apprun, size_t size)
+{
+   char version[1100], appdir[1200], tmp[1200], extracted[1300];
+   char *argv[] = { NULL, "--appimage-extract", NULL };
+   char *path;
+   const char *slash;
+   struct timespec start, end;
+   struct stat st;
+   int event;
+   bool ok;
+
+   // Set again below for this launch.
+   launch_unsetenv("APPDIR");
+   launch_unsetenv("APPIMAGE");
+
+   if (!enabled) {
+      return false;
+   }
+
+   path = realpath(appimage, NULL);
+   slash = path ? strrchr(path, '/') : NULL;
+
+   if (!slash) {
+      free(path);
+      return false;
+   }
+
+   snprintf(version, sizeof(version), "%.*s", (int)(slash - path), path);
+   snprintf(appdir, sizeof(appdir), "%s/AppDir", version);
+   snprintf(apprun, size, "%s/AppRun", appdir);
+
+   // Unpacked on the first launch of each version, a new version starts without one.
+   if (stat(apprun, &st) != 0) {
+      snprintf(tmp, sizeof(tmp), "%s/AppDir.tmp", version);
+      snprintf(extracted, sizeof(extracted), "%s/squashfs-root", tmp);
+      argv[0] = path;
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      event = trace_begin("AppImage unpack");
+      remove_tree(tmp);
+      remove_tree(appdir);
+
+      // The AppImage runtime always unpacks to squashfs-root in the working directory.
+      ok = make_dir(tmp) && launch_run_quiet(tmp, argv) == 0
+            && rename(extracted, appdir) == 0 && stat(apprun, &st) == 0;
+      remove_tree(tmp);
+      trace_end(event);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      if (!ok) {
+         launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot unpack %s, running it mounted.\n", path);
+         remove_tree(appdir);
+         free(path);
+         return false;
+      }
+
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Unpacked %s in %.1fs\n", path,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+   }
+
+   // Set by the AppImage runtime otherwise, AppRun finds its files through them.
+   launch_setenv("APPDIR", appdir);
+   launch_setenv("APPIMAGE", path);
+   free(path);
+   return true;
+}
@@ -0,0 +1,80 @@
+#ifndef LAUNCHER_INSTALL_H
+#define LAUNCHER_INSTALL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "archive.h"
+#include "cache.h"
+
+/**
+ * Versioned installs.
+ *
+ * Every release lives in its own folder, dir/versions/<asset id>, and
+ * dir/current is a symlink to the active one. A release is downloaded to
+ * dir/versions/<id>.tmp, renamed once complete and activated by replacing
+ * the symlink with a single rename, so a failed update or one made while
+ * the emulator runs never touches the installed version. Previous versions
+ * are kept for rollback, within the limits of install_set_limits().
+ */
+
+/**
+ * How the asset of a release is installed: saved as file (an AppImage),
+ * or, if file is NULL, extracted as an archive of format with the first
+ * strip path components of its entries removed.
+ */
+struct install_layout {
+   const char *file;
+   enum archive_format format;
+   int strip;
+};
+
+/**
+ * Number of previous versions kept besides the active one, and the disk
+ * budget in bytes for all versions, 0 for no limit.
+ */
+void install_set_limits(int keep, long long budget);
+
+/**
+ * Download the latest release of entry into its version folder, if it is
+ * not there yet. Old versions are collected afterwards.
+ */
+bool install_download(const struct cache_entry *entry, const char *dir, const struct install_layout *layout);
+
+/**
+ * Point dir/current at the downloaded version id.
+ */
+bool install_activate(const char *dir, const char *id);
+
+/**
+ * Copy the ID of the active version to id, false if there is none.
+ */
+bool install_active(const char *dir, char *id, size_t size);
+
+/**
+ * Copy the ID of the newest kept version older than the active one to id.
+ */
+bool install_previous(const char *dir, char *id, size_t size);
+
+/**
+ * Move a single file installed in dir itself, before versioned installs,
+ * to the version folder of id and activate it.
+ */
+bool install_adopt(const char *dir, const char *id, const struct install_layout *layout);
+
+/**
+ * Remove unfinished downloads, leftovers of the old shell extractor and the
+ * versions beyond the limits, oldest first. The active version and the
+ * current, staged and latest versions of entry are never removed.
+ */
+void install_collect(const char *dir, const struct cache_entry *entry);
+
+/**
+ * Copy the path of the AppRun of appimage, unpacked to AppDir in its
+ * version folder, to apprun. The AppImage is unpacked on the first call
+ * for each version, and later launches run it without mounting it.
+ * False when not enabled or unpacking fails, the AppImage then runs
+ * mounted and the AppDir of an earlier launch is no longer exported.
+ */
+bool install_appdir(const char *appimage, bool enabled, char *apprun, size_t size);
+
+#endif
@@ -0,0 +1,290 @@
+#include <string.h>
+#include "json.h"
+
+struct json_parser {
+   const char *cur;
+   const char *end;
+   struct json_path path;
+   json_visit_t visit;
+   void *userdata;
+};
+
+static bool parse_value(struct json_parser *p);
+
+static void skip_ws(struct json_parser *p)
+{
+   while (p->cur < p->end && (*p->cur == ' ' || *p->cur == '\t' || *p->cur == '\n' || *p->cur == '\r')) {
+      p->cur++;
+   }
+}
+
+/**
+ * Scan a string starting at the opening quote.
+ * On success start/len describe the raw content between the quotes.
+ */
+static bool scan_string(struct json_parser *p, const char **start, size_t *len)
+{
+   if (p->cur >= p->end || *p->cur != '"') {
+      return false;
+   }
+
+   p->cur++;
+   *start = p->cur;
+
+   while (p->cur < p->end && *p->cur != '"') {
+      if (*p->cur == '\\') {
+         p->cur++;
+      }
+      p->cur++;
+   }
+
+   if (p->cur >= p->end) {
+      return false;
+   }
+
+   *len = p->cur - *start;
+   p->cur++;
+   return true;
+}
+
+static bool parse_object(struct json_parser *p)
+{
+   struct json_frame *frame;
+
+   if (p->path.depth >= JSON_MAX_DEPTH) {
+      return false;
+   }
+
+   frame = &p->path.frames[p->path.depth++];
+   frame->index = -1;
+   p->cur++;
+   skip_ws(p);
+
+   if (p->cur < p->end && *p->cur == '}') {
+      p->cur++;
+      p->path.depth--;
+      return true;
+   }
+
+   while (p->cur < p->end) {
+      skip_ws(p);
+
+      if (!scan_string(p, &frame->key, &frame->key_len)) {
+         return false;
+      }
+
+      skip_ws(p);
+
+      if (p->cur >= p->end || *p->cur != ':') {
+         return false;
+      }
+
+      p->cur++;
+
+      if (!parse_value(p)) {
+         return false;
+      }
+
+      skip_ws(p);
+
+      if (p->cur < p->end && *p->cur == ',') {
+         p->cur++;
+      } else if (p->cur < p->end && *p->cur == '}') {
+         p->cur++;
+         p->path.depth--;
+         return true;
+      } else {
+         return false;
+      }
+   }
+   return false;
+}
+
+static bool parse_array(struct json_parser *p)
+{
+   struct json_frame *frame;
+
+   if (p->path.depth >= JSON_MAX_DEPTH) {
+      return false;
+   }
+
+   frame = &p->path.frames[p->path.depth++];
+   frame->key = NULL;
+   frame->key_len = 0;
+   frame->index = 0;
+   p->cur++;
+   skip_ws(p);
+
+   if (p->cur < p->end && *p->cur == ']') {
+      p->cur++;
+      p->path.depth--;
+      return true;
+   }
+
+   while (p->cur < p->end) {
+      if (!parse_value(p)) {
+         return false;
+      }
+
+      skip_ws(p);
+
+      if (p->cur < p->end && *p->cur == ',') {
+         p->cur++;
+         frame->index++;
+      } else if (p->cur < p->end && *p->cur == ']') {
+         p->cur++;
+         p->path.depth--;
+         return true;
+      } else {
+         return false;
+      }
+   }
+   return false;
+}
+
+static bool parse_literal(struct json_parser *p, const char *literal, enum json_type type)
+{
+   size_t len = strlen(literal);
+
+   if ((size_t)(p->end - p->cur) < len || memcmp(p->cur, literal, len) != 0) {
+      return false;
+   }
+
+   p->visit(&p->path, type, p->cur, len, p->userdata);
+   p->cur += len;
+   return true;
+}
+
+static bool parse_value(struct json_parser *p)
+{
+   const char *start;
+   size_t len;
+
+   skip_ws(p);
+
+   if (p->cur >= p->end) {
+      return false;
+   }
+
+   switch (*p->cur) {
+      case '{':
+         return parse_object(p);
+      case '[':
+         return parse_array(p);
+      case '"':
+         if (!scan_string(p, &start, &len)) {
+            return false;
+         }
+         p->visit(&p->path, JSON_STRING, start, len, p->userdata);
+         return true;
+      case 't':
+         return parse_literal(p, "true", JSON_BOOL);
+      case 'f':
+         return parse_literal(p, "false", JSON_BOOL);
+      case 'n':
+         return parse_literal(p, "null", JSON_NULL);
+      default:
+         start = p->cur;
+         while (p->cur < p->end && strchr("+-0123456789.eE", *p->cur) != NULL) {
+            p->cur++;
+         }
+         if (p->cur == start) {
+            return false;
+         }
+         p->visit(&p->path, JSON_NUMBER, start, p->cur - start, p->userdata);
+         return true;
+   }
+}
+
+bool json_walk(const char *json, size_t len, json_visit_t visit, void *userdata)
+{
+   struct json_parser p;
+
+   memset(&p, 0, sizeof(p));
+   p.cur = json;
+   p.end = json + len;
+   p.visit = visit;
+   p.userdata = userdata;
+
+   return parse_value(&p);
+}
+
+bool json_key_is(const struct json_frame *frame, const char *key)
+{
+   return frame->key != NULL && frame->key_len == strlen(key) && memcmp(frame->key, key, frame->key_len) == 0;
+}
+
+static int hex_value(char c)
+{
+   if (c >= '0' && c <= '9') return c - '0';
+   if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+   return -1;
+}
+
+bool json_unescape(const char *src, size_t len, char *dst, size_t dst_size)
+{
+   size_t out = 0;
+
+   for (size_t i = 0; i < len; i++) {
+      char c = src[i];
+      char utf8[4];
+      size_t n = 1;
+
+      if (c == '\\' && i + 1 < len) {
+         c = src[++i];
+         switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u': {
+               unsigned code = 0;
+
+               if (i + 4 >= len) {
+                  return false;
+               }
+               for (int k = 1; k <= 4; k++) {
+                  int v = hex_value(src[i + k]);
+                  if (v < 0) {
+                     return false;
+                  }
+                  code = (code << 4) | v;
+               }
+               i += 4;
+
+               // Surrogate pairs are not needed for release metadata, encode the BMP only.
+               if (code < 0x80) {
+                  c = code; // written as a plain character below
+               } else if (code < 0x800) {
+                  utf8[0] = 0xC0 | (code >> 6);
+                  utf8[1] = 0x80 | (code & 0x3F);
+                  n = 2;
+               } else {
+                  utf8[0] = 0xE0 | (code >> 12);
+                  utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+                  utf8[2] = 0x80 | (code & 0x3F);
+                  n = 3;
+               }
+               break;
+            }
+            default: break; // \" \\ \/
+         }
+      }
+
+      if (n == 1) {
+         utf8[0] = c;
+      }
+
+      if (out + n >= dst_size) {
+         return false;
+      }
+
+      memcpy(dst + out, utf8, n);
+      out += n;
+   }
+
+   dst[out] = '\0';
+   return true;
+}
@@ -0,0 +1,52 @@
+#ifndef LAUNCHER_JSON_H
+#define LAUNCHER_JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JSON_MAX_DEPTH 16
+
+enum json_type {
+   JSON_STRING,
+   JSON_NUMBER,
+   JSON_BOOL,
+   JSON_NULL
+};
+
+/**
+ * One step of the path leading to a value.
+ * Object members carry their (still escaped) key, array items their index.
+ */
+struct json_frame {
+   const char *key;
+   size_t key_len;
+   int index;
+};
+
+struct json_path {
+   struct json_frame frames[JSON_MAX_DEPTH];
+   int depth;
+};
+
+/**
+ * Called for every scalar in the document. String values are passed
+ * without quotes and still escaped, use json_unescape() to copy them out.
+ */
+typedef void (*json_visit_t)(const struct json_path *path, enum json_type type,
+      const char *value, size_t len, void *userdata);
+
+/**
+ * Walk a JSON document once, without building a tree.
+ * Returns false if the document is malformed or nested too deep.
+ */
+bool json_walk(const char *json, size_t len, json_visit_t visit, void *userdata);
+
+bool json_key_is(const struct json_frame *frame, const char *key);
+
+/**
+ * Copy an escaped JSON string into dst, always NUL terminated.
+ * Returns false if it did not fit.
+ */
+bool json_unescape(const char *src, size_t len, char *dst, size_t dst_size);
+
+#endif
@@ -0,0 +1,368 @@
+// For posix_spawn_file_actions_addchdir_np() and execvpe().
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/sched.h>
+#include "launch.h"
+#include "cpu.h"
+#include "cgroup.h"
+#include "log.h"
+
+#define MAX_VARIABLES 16
+
+// How spawn() starts a child.
+#define SPAWN_QUIET 1
+#define SPAWN_GROUP 2
+#define SPAWN_DETACH 4
+
+extern char **environ;
+
+// "NAME=value" entries added to the environment of the children.
+static char *variables[MAX_VARIABLES];
+static size_t num_variables;
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void log_command(char *const argv[])
+{
+   char line[2048] = {0};
+
+   for (size_t i = 0; argv[i] != NULL; i++) {
+      size_t len = strlen(line);
+
+      snprintf(line + len, sizeof(line) - len, i == 0 ? "%s" : " %s", argv[i]);
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Running %s\n", line);
+}
+
+static bool same_name(const char *a, const char *b)
+{
+   size_t len = strcspn(a, "=");
+
+   return strncmp(a, b, len) == 0 && b[len] == '=';
+}
+
+void launch_setenv(const char *name, const char *value)
+{
+   size_t len = strlen(name) + strlen(value) + 2;
+   char *variable = malloc(len);
+   size_t i;
+
+   if (!variable) {
+      return;
+   }
+
+   snprintf(variable, len, "%s=%s", name, value);
+
+   for (i = 0; i < num_variables && !same_name(variables[i], variable); i++);
+
+   if (i < num_variables) {
+      free(variables[i]);
+      variables[i] = variable;
+   } else if (num_variables < MAX_VARIABLES) {
+      variables[num_variables++] = variable;
+   } else {
+      free(variable);
+   }
+}
+
+void launch_unsetenv(const char *name)
+{
+   for (size_t i = 0; i < num_variables; i++) {
+      if (same_name(name, variables[i])) {
+         free(variables[i]);
+         variables[i] = variables[--num_variables];
+         return;
+      }
+   }
+}
+
+/**
+ * The environment of the frontend with the launcher's variables on top.
+ * The strings are shared, only the array is allocated.
+ */
+static char **child_environment(void)
+{
+   size_t count = 0, n = 0;
+   char **env;
+
+   while (environ[count] != NULL) {
+      count++;
+   }
+
+   if (!(env = malloc((count + num_variables + 1) * sizeof(char *)))) {
+      return NULL;
+   }
+
+   for (size_t i = 0; i < count; i++) {
+      bool replaced = false;
+
+      for (size_t j = 0; j < num_variables && !replaced; j++) {
+         replaced = same_name(variables[j], environ[i]);
+      }
+      if (!replaced) {
+         env[n++] = environ[i];
+      }
+   }
+
+   for (size_t j = 0; j < num_variables; j++) {
+      env[n++] = variables[j];
+   }
+
+   env[n] = NULL;
+   return env;
+}
+
+/**
+ * Start the child in the cgroup of cgroup_fd with clone3(CLONE_INTO_CGROUP),
+ * so whatever it starts before its first instruction ran lands there too.
+ * Returns 0 or the errno of a failed exec, like posix_spawnp(), and -1
+ * when clone3 can't do it, before Linux 5.7 for instance.
+ */
+static int spawn_into_cgroup(pid_t *pid, int cgroup_fd, const char *dir, char *const argv[], char *const env[],
+      int flags, int output, const sigset_t *defaults)
+{
+   struct clone_args args;
+   int fds[2], err = 0;
+   ssize_t n;
+   pid_t child;
+
+   if (pipe2(fds, O_CLOEXEC) != 0) {
+      return -1;
+   }
+
+   memset(&args, 0, sizeof(args));
+   args.flags = CLONE_INTO_CGROUP;
+   args.exit_signal = SIGCHLD;
+   args.cgroup = (unsigned)cgroup_fd;
+
+   child = (pid_t)syscall(SYS_clone3, &args, sizeof(args));
+
+   if (child == 0) {
+      // A copy of this thread only, async-signal-safe calls until exec.
+      sigset_t empty;
+
+      for (int sig = 1; sig < NSIG; sig++) {
+         if (sigismember(defaults, sig) == 1) {
+            signal(sig, SIG_DFL);
+         }
+      }
+
+      sigemptyset(&empty);
+      sigprocmask(SIG_SETMASK, &empty, NULL);
+
+      if (((flags & SPAWN_GROUP) && setpgid(0, 0) != 0) || (dir && chdir(dir) != 0)
+            || (output >= 0 && dup2(output, STDOUT_FILENO) < 0)) {
+         err = errno;
+      } else {
+         execvpe(argv[0], argv, env);
+         err = errno;
+      }
+
+      // The pipe closes on exec, anything read from it is why there was none.
+      n = write(fds[1], &err, sizeof(err));
+      _exit(127);
+   }
+
+   close(fds[1]);
+
+   if (child < 0) {
+      close(fds[0]);
+      return -1;
+   }
+
+   while ((n = read(fds[0], &err, sizeof(err))) < 0 && errno == EINTR);
+   close(fds[0]);
+
+   if (n == sizeof(err)) {
+      waitpid(child, NULL, 0);
+      return err;
+   }
+
+   *pid = child;
+   return 0;
+}
+
+static pid_t spawn(const char *dir, char *const argv[], int flags, int output)
+{
+   static const int reset[] = { SIGINT, SIGQUIT, SIGTERM, SIGHUP, SIGPIPE, SIGCHLD };
+   posix_spawn_file_actions_t actions;
+   posix_spawnattr_t attr;
+   sigset_t mask, defaults;
+   double start = now();
+   char **env = child_environment();
+   int err = -1, cgroup_fd = -1;
+   bool placed = false;
+   pid_t pid;
+
+   if (!env) {
+      return -1;
+   }
+
+   log_command(argv);
+
+   // The frontend and libcurl may block or ignore signals, the emulator gets a clean slate.
+   sigemptyset(&mask);
+   sigemptyset(&defaults);
+
+   for (size_t i = 0; i < sizeof(reset) / sizeof(reset[0]); i++) {
+      sigaddset(&defaults, reset[i]);
+   }
+
+   posix_spawnattr_init(&attr);
+   posix_spawnattr_setsigmask(&attr, &mask);
+   posix_spawnattr_setsigdefault(&attr, &defaults);
+   posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF
+         | (flags & SPAWN_GROUP ? POSIX_SPAWN_SETPGROUP : 0) | (flags & SPAWN_DETACH ? POSIX_SPAWN_SETSID : 0));
+
+   posix_spawn_file_actions_init(&actions);
+
+   if (dir) {
+      posix_spawn_file_actions_addchdir_np(&actions, dir);
+   }
+   if (output >= 0) {
+      posix_spawn_file_actions_adddup2(&actions, output, STDOUT_FILENO);
+   } else if (flags & SPAWN_QUIET) {
+      posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+   }
+
+   // Helpers stay where the frontend is, a detached child would pass the placement on to the restarted frontend.
+   if (!(flags & (SPAWN_QUIET | SPAWN_DETACH))) {
+      cpu_spawn_begin();
+      cgroup_fd = cgroup_spawn_begin();
+   }
+
+   if (cgroup_fd >= 0) {
+      err = spawn_into_cgroup(&pid, cgroup_fd, dir, argv, env, flags, output, &defaults);
+      placed = err == 0;
+   }
+
+   // glibc spawns with vfork semantics, the address space of the frontend is never copied.
+   if (err < 0) {
+      err = posix_spawnp(&pid, argv[0], &actions, &attr, argv, env);
+   }
+
+   if (!(flags & (SPAWN_QUIET | SPAWN_DETACH))) {
+      cpu_spawn_end(err == 0 ? pid : -1);
+      cgroup_spawn_end(err == 0 ? pid : -1, placed);
+   }
+   posix_spawn_file_actions_destroy(&actions);
+   posix_spawnattr_destroy(&attr);
+   free(env);
+
+   if (err != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot start %s: %s\n", argv[0], strerror(err));
+      return -1;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Started pid %d in %.2f ms\n", (int)pid, (now() - start) * 1000);
+   return pid;
+}
+
+pid_t launch_spawn(char *const argv[])
+{
+   return spawn(NULL, argv, 0, -1);
+}
+
+pid_t launch_spawn_group(char *const argv[])
+{
+   return spawn(NULL, argv, SPAWN_GROUP, -1);
+}
+
+pid_t launch_spawn_detached(char *const argv[])
+{
+   return spawn(NULL, argv, SPAWN_DETACH, -1);
+}
+
+int launch_wait(pid_t pid)
+{
+   int status;
+
+   while (waitpid(pid, &status, 0) < 0) {
+      if (errno != EINTR) {
+         return -1;
+      }
+   }
+
+   cgroup_reaped(pid);
+
+   if (WIFSIGNALED(status)) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: pid %d killed by signal %d\n", (int)pid, WTERMSIG(status));
+      return -1;
+   }
+
+   return WEXITSTATUS(status);
+}
+
+int launch_run(char *const argv[])
+{
+   pid_t pid = launch_spawn(argv);
+
+   return pid < 0 ? -1 : launch_wait(pid);
+}
+
+int launch_run_quiet(const char *dir, char *const argv[])
+{
+   pid_t pid = spawn(dir, argv, SPAWN_QUIET, -1);
+
+   return pid < 0 ? -1 : launch_wait(pid);
+}
+
+pid_t launch_spawn_quiet(char *const argv[])
+{
+   return spawn(NULL, argv, SPAWN_QUIET, -1);
+}
+
+int launch_output(char *const argv[], char *out, size_t size)
+{
+   char discard[256];
+   size_t len = 0;
+   int fds[2];
+   pid_t pid;
+
+   out[0] = '\0';
+
+   if (pipe2(fds, O_CLOEXEC) != 0) {
+      return -1;
+   }
+
+   pid = spawn(NULL, argv, SPAWN_QUIET, fds[1]);
+   close(fds[1]);
+
+   // Read all of it, a child writing into a full pipe would never exit.
+   for (;;) {
+      char *buf = len + 1 < size ? out + len : discard;
+      size_t room = len + 1 < size ? size - len - 1 : sizeof(discard);
+      ssize_t n = read(fds[0], buf, room);
+
+      if (n == 0 || (n < 0 && errno != EINTR)) {
+         break;
+      }
+      if (n > 0 && buf != discard) {
+         len += n;
+      }
+   }
+   close(fds[0]);
+
+   out[len] = '\0';
+   out[strcspn(out, "\n")] = '\0';
+
+   return pid < 0 ? -1 : launch_wait(pid);
+}
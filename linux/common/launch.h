@@ -0,0 +1,66 @@
+#ifndef LAUNCHER_LAUNCH_H
+#define LAUNCHER_LAUNCH_H
+
+#include <sys/types.h>
+
+/**
+ * Start the emulator with argv, argv[0] being its path, or a command
+ * looked up in PATH like "wine". No shell is involved, so arguments such
+ * as ROM paths are passed as they are, without quoting or length limits.
+ * Returns the pid of the child, or -1 if it could not be started.
+ */
+pid_t launch_spawn(char *const argv[]);
+
+/**
+ * launch_spawn() in a process group of its own, led by the child, so the
+ * emulator can be stopped together with the processes it starts.
+ */
+pid_t launch_spawn_group(char *const argv[]);
+
+/**
+ * launch_spawn() in a new session, detached from the frontend and its
+ * terminal, so it keeps running after the frontend quits.
+ */
+pid_t launch_spawn_detached(char *const argv[]);
+
+/**
+ * Wait for a child started by launch_spawn(). Returns its exit status,
+ * or -1 if it was killed by a signal.
+ */
+int launch_wait(pid_t pid);
+
+/**
+ * launch_spawn() and launch_wait() in one call.
+ */
+int launch_run(char *const argv[]);
+
+/**
+ * launch_run() in the working directory dir, with the output of the child
+ * discarded. For helper commands run before the emulator.
+ */
+int launch_run_quiet(const char *dir, char *const argv[]);
+
+/**
+ * launch_spawn() for a helper, its output is discarded and it is neither
+ * placed like an emulator nor accounted as one.
+ */
+pid_t launch_spawn_quiet(char *const argv[]);
+
+/**
+ * launch_run() keeping the first line the command prints in out, like the
+ * version of a tool.
+ */
+int launch_output(char *const argv[], char *out, size_t size);
+
+/**
+ * Set name to value in the environment of the children started from now
+ * on. The environment of the frontend itself is left alone.
+ */
+void launch_setenv(const char *name, const char *value);
+
+/**
+ * Take back a variable of launch_setenv().
+ */
+void launch_unsetenv(const char *name);
+
+#endif
@@ -0,0 +1,14 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include "log.h"
+
+static void fallback_log(enum retro_log_level level, const char *fmt, ...)
+{
+   (void)level;
+   va_list va;
+   va_start(va, fmt);
+   vfprintf(stderr, fmt, va);
+   va_end(va);
+}
+
+retro_log_printf_t launcher_log = fallback_log;
@@ -0,0 +1,12 @@
+#ifndef LAUNCHER_LOG_H
+#define LAUNCHER_LOG_H
+
+#include "libretro.h"
+
+/**
+ * Log callback used by the shared launcher code.
+ * Launchers point it at their own log_cb once the frontend provided one.
+ */
+extern retro_log_printf_t launcher_log;
+
+#endif
@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <string.h>
+#include "md4.h"
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define G(x, y, z) (((x) & (y)) | ((x) & (z)) | ((y) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+static void transform(uint32_t state[4], const unsigned char *p)
+{
+   static const int r2[16] = { 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15 };
+   static const int r3[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+   static const int s1[4] = { 3, 7, 11, 19 }, s2[4] = { 3, 5, 9, 13 }, s3[4] = { 3, 9, 11, 15 };
+   uint32_t x[16], a = state[0], b = state[1], c = state[2], d = state[3], t;
+
+   for (int i = 0; i < 16; i++) {
+      x[i] = p[i * 4] | (p[i * 4 + 1] << 8) | (p[i * 4 + 2] << 16) | ((uint32_t)p[i * 4 + 3] << 24);
+   }
+
+   for (int i = 0; i < 16; i++) {
+      t = ROL(a + F(b, c, d) + x[i], s1[i % 4]);
+      a = d; d = c; c = b; b = t;
+   }
+   for (int i = 0; i < 16; i++) {
+      t = ROL(a + G(b, c, d) + x[r2[i]] + 0x5a827999, s2[i % 4]);
+      a = d; d = c; c = b; b = t;
+   }
+   for (int i = 0; i < 16; i++) {
+      t = ROL(a + H(b, c, d) + x[r3[i]] + 0x6ed9eba1, s3[i % 4]);
+      a = d; d = c; c = b; b = t;
+   }
+
+   state[0] += a;
+   state[1] += b;
+   state[2] += c;
+   state[3] += d;
+}
+
+void md4(const void *data, size_t len, unsigned char digest[16])
+{
+   uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+   const unsigned char *p = data;
+   unsigned char block[128] = {0};
+   uint64_t bits = (uint64_t)len * 8;
+   size_t tail, pad;
+
+   for (; len >= 64; p += 64, len -= 64) {
+      transform(state, p);
+   }
+
+   memcpy(block, p, len);
+   block[len] = 0x80;
+   tail = len < 56 ? 64 : 128;
+
+   for (int i = 0; i < 8; i++) {
+      block[tail - 8 + i] = bits >> (i * 8);
+   }
+
+   for (pad = 0; pad < tail; pad += 64) {
+      transform(state, block + pad);
+   }
+
+   for (int i = 0; i < 4; i++) {
+      digest[i * 4] = state[i];
+      digest[i * 4 + 1] = state[i] >> 8;
+      digest[i * 4 + 2] = state[i] >> 16;
+      digest[i * 4 + 3] = state[i] >> 24;
+   }
+}
@@ -0,0 +1,11 @@
+#ifndef LAUNCHER_MD4_H
+#define LAUNCHER_MD4_H
+
+#include <stddef.h>
+
+/**
+ * MD4 of one buffer. Only used for the block checksums of zsync files.
+ */
+void md4(const void *data, size_t len, unsigned char digest[16]);
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mirror.h"
+#include "log.h"
+
+#define DOWN_SECONDS 300
+
+static char mirror[512];
+static bool index_format;
+static time_t down_until;
+
+void mirror_load(const char *path)
+{
+   char line[600], url[512] = {0}, format[16] = "github";
+   FILE *file = fopen(path, "r");
+
+   mirror[0] = '\0';
+
+   if (!file) {
+      return;
+   }
+
+   while (fgets(line, sizeof(line), file)) {
+      char *value = strchr(line, '=');
+      char *key = line;
+
+      if (line[0] == '#' || !value) {
+         continue;
+      }
+
+      *value++ = '\0';
+      value += strspn(value, " \t");
+      value[strcspn(value, " \t\r\n")] = '\0';
+      key[strcspn(key, " \t")] = '\0';
+
+      if (strcmp(key, "url") == 0) {
+         snprintf(url, sizeof(url), "%s", value);
+      } else if (strcmp(key, "format") == 0) {
+         snprintf(format, sizeof(format), "%s", value);
+      }
+   }
+
+   fclose(file);
+
+   if (strcmp(format, "github") != 0 && strcmp(format, "index") != 0) {
+      launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Unknown release mirror format %s in %s, the mirror is off.\n",
+            format, path);
+      return;
+   }
+
+   // The paths appended to it start with a slash.
+   while (url[0] != '\0' && url[strlen(url) - 1] == '/') {
+      url[strlen(url) - 1] = '\0';
+   }
+
+   if (url[0] == '\0') {
+      return;
+   }
+
+   snprintf(mirror, sizeof(mirror), "%s", url);
+   index_format = strcmp(format, "index") == 0;
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Release mirror: %s (%s format)\n", mirror, format);
+}
+
+bool mirror_url(const char *url, char *out, size_t size)
+{
+   const char *repo, *rest;
+   int len;
+
+   if (mirror[0] == '\0' || time(NULL) < down_until) {
+      return false;
+   }
+
+   // API: <host>/repos/<owner>/<repo>/releases/latest
+   if ((repo = strstr(url, "/repos/")) && (rest = strstr(repo, "/releases/latest"))) {
+      repo += strlen("/repos");
+      len = index_format ? snprintf(out, size, "%s%.*s/index.json", mirror, (int)(rest - repo), repo)
+            : snprintf(out, size, "%s/repos%s", mirror, repo);
+      return len > 0 && (size_t)len < size;
+   }
+
+   // Asset: <host>/<owner>/<repo>/releases/download/<tag>/<name>
+   if ((repo = strstr(url, "://")) && (repo = strchr(repo + 3, '/')) && (rest = strstr(repo, "/releases/download/"))) {
+      len = index_format ? snprintf(out, size, "%s%.*s/%s", mirror, (int)(rest - repo), repo,
+                  rest + strlen("/releases/download/"))
+            : snprintf(out, size, "%s%s", mirror, repo);
+      return len > 0 && (size_t)len < size;
+   }
+
+   return false;
+}
+
+void mirror_down(void)
+{
+   if (mirror[0] != '\0') {
+      launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Release mirror %s is unreachable, using GitHub for %d minutes.\n",
+            mirror, DOWN_SECONDS / 60);
+      down_until = time(NULL) + DOWN_SECONDS;
+   }
+}
@@ -0,0 +1,39 @@
+#ifndef LAUNCHER_MIRROR_H
+#define LAUNCHER_MIRROR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Release mirror.
+ *
+ * Machines on one network can take their releases from a mirror or cache
+ * there instead of GitHub, set in a file like system/launcher.mirror:
+ *
+ *    url = http://cache.lan:8080
+ *    format = index
+ *
+ * With format github (the default) the mirror answers on the paths of
+ * GitHub: url/repos/<owner>/<repo>/releases/latest and
+ * url/<owner>/<repo>/releases/download/<tag>/<name>. With format index
+ * any static file server will do: url/<owner>/<repo>/index.json holds the
+ * releases/latest document of GitHub, or just its tag_name, published_at
+ * and the name, id, size and digest of each asset, and the assets are at
+ * url/<owner>/<repo>/<tag>/<name>. Anything the mirror fails to serve
+ * comes from GitHub. A mirror that is behind is not followed back to an
+ * older release. Without the file there is no mirror.
+ */
+void mirror_load(const char *path);
+
+/**
+ * The mirror URL of a GitHub API or asset URL. False without a mirror,
+ * while it is down, or for other URLs.
+ */
+bool mirror_url(const char *url, char *out, size_t size);
+
+/**
+ * Leave the mirror out for a few minutes, it could not be reached.
+ */
+void mirror_down(void);
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "options.h"
+
+struct option_def {
+   const char *name;
+   const char *value; // "Description; default|other|..."
+};
+
+static const struct option_def definitions[] = {
+   { "cache_ttl", "Update check interval; 1 hour|every launch|15 minutes|6 hours|24 hours" },
+   { "update_mode", "Update mode; blocking|background" },
+   { "download_connections", "Download connections; 4|1|2|8|16" },
+   { "download_segment_size", "Download segment size; 8 MB|4 MB|16 MB|32 MB" },
+   { "keep_versions", "Previous versions kept; 1|0|2|3" },
+   { "disk_budget", "Disk budget for versions; unlimited|1 GB|2 GB|5 GB|10 GB" },
+   { "content_prefetch", "Content prefetch; 64 MB|off|16 MB|256 MB|1024 MB" },
+   { "appimage_mode", "AppImage mode; mounted|extracted" },
+   { "session_mode", "Session mode; blocking|supervised|handoff" },
+   { "idle_frontend", "Idle frontend in supervised sessions; enabled|disabled" },
+   { "cpu_placement", "Emulator CPU placement; off|performance cores|cache die|fast die" },
+   { "cpu_smt", "Emulator SMT threads; all|one per core" },
+   { "emulator_priority", "Emulator priority boost; off|5|10|15" },
+   { "resource_groups", "cgroup resource groups; enabled|disabled" },
+   { "launch_trace", "Launch trace file; disabled|enabled" },
+};
+
+#define NUM_OPTIONS (sizeof(definitions) / sizeof(definitions[0]))
+
+static retro_environment_t environ_cb;
+static char prefix[64];
+static char keys[NUM_OPTIONS][128];
+
+void options_init(retro_environment_t cb, const char *core)
+{
+   struct retro_variable vars[NUM_OPTIONS + 1];
+
+   environ_cb = cb;
+   snprintf(prefix, sizeof(prefix), "%s_launcher_", core);
+
+   for (size_t i = 0; i < NUM_OPTIONS; i++) {
+      snprintf(keys[i], sizeof(keys[i]), "%s%s", prefix, definitions[i].name);
+      vars[i].key = keys[i];
+      vars[i].value = definitions[i].value;
+   }
+
+   vars[NUM_OPTIONS].key = NULL;
+   vars[NUM_OPTIONS].value = NULL;
+   cb(RETRO_ENVIRONMENT_SET_VARIABLES, vars);
+}
+
+/**
+ * Default of an option is the first value after "; ".
+ */
+static const char *default_value(const struct option_def *def, char *buf, size_t size)
+{
+   const char *start = strstr(def->value, "; ");
+   size_t len;
+
+   start = start ? start + 2 : def->value;
+   len = strcspn(start, "|");
+   snprintf(buf, size, "%.*s", (int)len, start);
+   return buf;
+}
+
+const char *options_get(const char *name)
+{
+   static char fallback[64];
+   struct retro_variable var = { NULL, NULL };
+
+   for (size_t i = 0; i < NUM_OPTIONS; i++) {
+      if (strcmp(definitions[i].name, name) != 0) {
+         continue;
+      }
+
+      var.key = keys[i];
+
+      if (environ_cb && environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+         return var.value;
+      }
+      return default_value(&definitions[i], fallback, sizeof(fallback));
+   }
+   return NULL;
+}
+
+long options_get_number(const char *name)
+{
+   const char *value = options_get(name);
+
+   return value ? strtol(value, NULL, 10) : 0;
+}
+
+long options_get_seconds(const char *name)
+{
+   const char *value = options_get(name);
+   char *unit;
+   long amount;
+
+   if (!value) {
+      return 0;
+   }
+
+   amount = strtol(value, &unit, 10);
+
+   if (unit == value) {
+      return 0; // "every launch"
+   }
+
+   while (*unit == ' ') {
+      unit++;
+   }
+
+   if (strncmp(unit, "minute", 6) == 0) {
+      return amount * 60;
+   } else if (strncmp(unit, "hour", 4) == 0) {
+      return amount * 3600;
+   }
+   return amount;
+}
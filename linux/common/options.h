@@ -0,0 +1,28 @@
+#ifndef LAUNCHER_OPTIONS_H
+#define LAUNCHER_OPTIONS_H
+
+#include "libretro.h"
+
+/**
+ * Register the launcher core options. Keys are prefixed with
+ * "<core>_launcher_" so every launcher gets its own set.
+ * Call from retro_set_environment().
+ */
+void options_init(retro_environment_t cb, const char *core);
+
+/**
+ * Current value of option name (without prefix), or NULL.
+ */
+const char *options_get(const char *name);
+
+/**
+ * Leading number of an option value like "8 MB".
+ */
+long options_get_number(const char *name);
+
+/**
+ * Value of a duration option like "15 minutes" or "every launch", in seconds.
+ */
+long options_get_seconds(const char *name);
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "prefetch.h"
+#include "log.h"
+
+#define CHUNK (4 * 1048576LL)
+#define MAX_DEPTH 8
+// An emulator folder is a few hundred MB at most, don't flush the page cache for a bigger one.
+#define FOLDER_LIMIT (2048 * 1048576LL)
+
+struct prefetch_job {
+   char dir[1024];
+   char content[4096];
+   long long content_bytes;
+   long long bytes;
+   unsigned files;
+};
+
+static pthread_t worker;
+static bool worker_running;
+static volatile int prefetch_cancelled;
+static struct prefetch_job job;
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Read up to limit bytes of the file at fd into the page cache, -1 for all
+ * of it. The kernel reads in the background, each call only queues a chunk.
+ */
+static void prefetch_fd(int fd, long long limit)
+{
+   struct stat st;
+   long long size;
+
+   if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      return;
+   }
+
+   size = limit >= 0 && limit < st.st_size ? limit : st.st_size;
+
+   for (long long offset = 0; offset < size && !prefetch_cancelled; offset += CHUNK) {
+      long long len = size - offset < CHUNK ? size - offset : CHUNK;
+
+      posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+      job.bytes += len;
+   }
+
+   job.files++;
+}
+
+static void prefetch_tree(int parent, const char *name, int depth)
+{
+   struct dirent *e;
+   struct stat st;
+   DIR *d;
+   int fd;
+
+   if (prefetch_cancelled || job.bytes >= FOLDER_LIMIT
+         || fstatat(parent, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+      return;
+   }
+
+   if (S_ISREG(st.st_mode)) {
+      if ((fd = openat(parent, name, O_RDONLY | O_CLOEXEC)) >= 0) {
+         prefetch_fd(fd, FOLDER_LIMIT - job.bytes);
+         close(fd);
+      }
+      return;
+   }
+
+   if (!S_ISDIR(st.st_mode) || depth >= MAX_DEPTH
+         || (fd = openat(parent, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+      return;
+   }
+
+   if (!(d = fdopendir(fd))) {
+      close(fd);
+      return;
+   }
+
+   while ((e = readdir(d)) != NULL) {
+      if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+         prefetch_tree(dirfd(d), e->d_name, depth + 1);
+      }
+   }
+   closedir(d);
+}
+
+static void *prefetch_worker(void *arg)
+{
+   double start = now();
+   long long emulator;
+   int fd;
+
+   (void)arg;
+
+   // The emulator first, it is needed before the content.
+   prefetch_tree(AT_FDCWD, job.dir, 0);
+   emulator = job.bytes;
+
+   if (job.content[0] != '\0' && (fd = open(job.content, O_RDONLY | O_CLOEXEC)) >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      prefetch_fd(fd, job.content_bytes);
+      close(fd);
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Prefetch queued %.1f MB of emulator and %.1f MB of content (%u files) in %.2fs\n",
+         emulator / 1048576.0, (job.bytes - emulator) / 1048576.0, job.files, now() - start);
+   return NULL;
+}
+
+bool prefetch_start(const char *executable, const char *content, long long content_bytes)
+{
+   const char *slash = strrchr(executable, '/');
+   char *dir;
+
+   if (worker_running || !slash) {
+      return false;
+   }
+
+   memset(&job, 0, sizeof(job));
+   snprintf(job.dir, sizeof(job.dir), "%.*s", (int)(slash - executable), executable);
+
+   // Through the current link, to the version folder with the bundled libraries.
+   if ((dir = realpath(job.dir, NULL)) != NULL) {
+      snprintf(job.dir, sizeof(job.dir), "%s", dir);
+      free(dir);
+   }
+
+   if (content != NULL && content_bytes != 0) {
+      snprintf(job.content, sizeof(job.content), "%s", content);
+      job.content_bytes = content_bytes;
+   }
+
+   prefetch_cancelled = 0;
+
+   if (pthread_create(&worker, NULL, prefetch_worker, NULL) != 0) {
+      return false;
+   }
+
+   worker_running = true;
+   return true;
+}
+
+void prefetch_stop(void)
+{
+   if (!worker_running) {
+      return;
+   }
+
+   prefetch_cancelled = 1;
+   pthread_join(worker, NULL);
+   worker_running = false;
+}
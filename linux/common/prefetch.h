@@ -0,0 +1,22 @@
+#ifndef LAUNCHER_PREFETCH_H
+#define LAUNCHER_PREFETCH_H
+
+#include <stdbool.h>
+
+/**
+ * Page cache prefetch.
+ *
+ * A worker thread asks the kernel to read the installed emulator, the
+ * folder of executable with everything in it, and the first content_bytes
+ * of content into the page cache, while the launcher checks for updates.
+ * On a cold HDD or network share the emulator then starts from memory.
+ * content may be NULL, content_bytes 0 skips it, -1 reads all of it.
+ */
+bool prefetch_start(const char *executable, const char *content, long long content_bytes);
+
+/**
+ * Stop an unfinished prefetch and wait for its thread.
+ */
+void prefetch_stop(void);
+
+#endif
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "release.h"
+#include "http.h"
+#include "json.h"
+#include "log.h"
+#include "mirror.h"
+#include "trace.h"
+
+#define MAX_ZSYNC_ASSETS 8
+
+struct release_visitor {
+   struct release *rel;
+   int asset;
+   bool ok;
+   char zsync[MAX_ZSYNC_ASSETS][256];
+   int zsync_count;
+};
+
+static void copy_value(struct release_visitor *v, const char *value, size_t len, char *dst, size_t size)
+{
+   if (!json_unescape(value, len, dst, size)) {
+      v->ok = false;
+   }
+}
+
+static void visit_release(const struct json_path *path, enum json_type type,
+      const char *value, size_t len, void *userdata)
+{
+   struct release_visitor *v = userdata;
+   const struct json_frame *f = path->frames;
+
+   if (path->depth == 1 && type == JSON_STRING && json_key_is(&f[0], "tag_name")) {
+      copy_value(v, value, len, v->rel->tag, sizeof(v->rel->tag));
+      return;
+   }
+
+   if (path->depth == 1 && type == JSON_STRING && json_key_is(&f[0], "published_at")) {
+      copy_value(v, value, len, v->rel->published, sizeof(v->rel->published));
+      return;
+   }
+
+   if (path->depth != 3 || !json_key_is(&f[0], "assets")) {
+      return;
+   }
+
+   // Remember the zsync control files of all assets, matched against the asset name later.
+   if (type == JSON_STRING && json_key_is(&f[2], "name") && len > 6 && strncmp(value + len - 6, ".zsync", 6) == 0
+         && v->zsync_count < MAX_ZSYNC_ASSETS) {
+      copy_value(v, value, len, v->zsync[v->zsync_count], sizeof(v->zsync[0]));
+      v->zsync_count++;
+   }
+
+   // assets[asset].<field>
+   if (f[1].index != v->asset) {
+      return;
+   }
+
+   if (type == JSON_STRING && json_key_is(&f[2], "name")) {
+      copy_value(v, value, len, v->rel->name, sizeof(v->rel->name));
+   } else if (type == JSON_NUMBER && json_key_is(&f[2], "id")) {
+      copy_value(v, value, len, v->rel->id, sizeof(v->rel->id));
+   } else if (type == JSON_STRING && json_key_is(&f[2], "digest")) {
+      copy_value(v, value, len, v->rel->digest, sizeof(v->rel->digest));
+   } else if (type == JSON_NUMBER && json_key_is(&f[2], "size")) {
+      v->rel->size = strtoll(value, NULL, 10);
+   }
+}
+
+bool release_parse(const char *json, size_t len, int asset, const char *download_url, struct release *rel)
+{
+   struct release_visitor v = { rel, asset, true, {{0}}, 0 };
+
+   memset(rel, 0, sizeof(*rel));
+
+   if (!json_walk(json, len, visit_release, &v) || !v.ok) {
+      return false;
+   }
+
+   if (rel->tag[0] == '\0' || rel->name[0] == '\0' || rel->id[0] == '\0') {
+      return false;
+   }
+
+   // "<asset>.zsync", or the only zsync file of the release.
+   for (int i = 0; i < v.zsync_count; i++) {
+      size_t name_len = strlen(rel->name);
+
+      if ((strncmp(v.zsync[i], rel->name, name_len) == 0 && strcmp(v.zsync[i] + name_len, ".zsync") == 0)
+            || v.zsync_count == 1) {
+         snprintf(rel->zsync, sizeof(rel->zsync), "%s%s/%s", download_url, rel->tag, v.zsync[i]);
+         break;
+      }
+   }
+
+   return (size_t)snprintf(rel->url, sizeof(rel->url), "%s%s/%s", download_url, rel->tag, rel->name) < sizeof(rel->url);
+}
+
+/**
+ * url with host replaced by LAUNCHER_GITHUB_URL, when that is set.
+ */
+static const char *github_url(const char *url, const char *host, char *out, size_t size)
+{
+   const char *base = getenv("LAUNCHER_GITHUB_URL");
+   size_t len = strlen(host);
+
+   if (!base || base[0] == '\0' || strncmp(url, host, len) != 0) {
+      return url;
+   }
+
+   len = strlen(base);
+   snprintf(out, size, "%.*s/%s", (int)(base[len - 1] == '/' ? len - 1 : len), base, url + strlen(host));
+   return out;
+}
+
+/**
+ * release_fetch() from one server, reached tells if it answered at all.
+ */
+static enum release_status fetch(const char *api_url, const char *download_url, int asset,
+      struct release *rel, struct release_validators *validators, bool *reached)
+{
+   const char *headers[4] = { "Accept: application/json", NULL };
+   char if_none_match[160] = {0}, if_modified_since[96] = {0};
+   struct http_response resp;
+   size_t count = 1;
+   bool ok;
+
+   if (validators && validators->etag[0] != '\0') {
+      snprintf(if_none_match, sizeof(if_none_match), "If-None-Match: %s", validators->etag);
+      headers[count++] = if_none_match;
+   }
+   if (validators && validators->last_modified[0] != '\0') {
+      snprintf(if_modified_since, sizeof(if_modified_since), "If-Modified-Since: %s", validators->last_modified);
+      headers[count++] = if_modified_since;
+   }
+
+   if (!(*reached = http_get(api_url, headers, &resp))) {
+      return RELEASE_FAILED;
+   }
+
+   if (resp.status == 304 && count > 1) {
+      http_response_free(&resp);
+      return RELEASE_NOT_MODIFIED;
+   }
+
+   if (resp.status != 200) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: %s returned HTTP %ld\n", api_url, resp.status);
+      http_response_free(&resp);
+      return RELEASE_FAILED;
+   }
+
+   ok = release_parse(resp.body, resp.body_len, asset, download_url, rel);
+
+   if (ok && validators) {
+      memcpy(validators->etag, resp.etag, sizeof(validators->etag));
+      memcpy(validators->last_modified, resp.last_modified, sizeof(validators->last_modified));
+   }
+
+   http_response_free(&resp);
+
+   if (!ok) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Unexpected release metadata from %s\n", api_url);
+      return RELEASE_FAILED;
+   }
+   return RELEASE_FETCHED;
+}
+
+enum release_status release_fetch(const char *api_url, const char *download_url, int asset,
+      struct release *rel, struct release_validators *validators, struct release_validators *mirror_validators)
+{
+   char api[1024], download[1024], mirror[1024];
+   enum release_status status;
+   bool reached;
+
+   api_url = github_url(api_url, "https://api.github.com/", api, sizeof(api));
+   download_url = github_url(download_url, "https://github.com/", download, sizeof(download));
+
+   // The mirror on the local network first. The asset URLs stay the ones of GitHub, downloads map them again.
+   if (mirror_url(api_url, mirror, sizeof(mirror))) {
+      status = fetch(mirror, download_url, asset, rel, mirror_validators, &reached);
+
+      if (status != RELEASE_FAILED) {
+         rel->mirrored = true;
+         return status;
+      }
+
+      if (!reached) {
+         mirror_down();
+      }
+
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: No release from the mirror, asking GitHub.\n");
+   }
+
+   return fetch(api_url, download_url, asset, rel, validators, &reached);
+}
+
+/**
+ * True if rel is older than the latest release of entry. Dates in ISO 8601
+ * sort as text. Without them the asset IDs tell, GitHub numbers assets in
+ * the order they were uploaded.
+ */
+static bool older(const struct release *rel, const struct cache_entry *entry)
+{
+   size_t len = strlen(rel->id), latest_len = strlen(entry->latest);
+
+   if (rel->published[0] != '\0' && entry->published[0] != '\0') {
+      return strcmp(rel->published, entry->published) < 0;
+   }
+   return len < latest_len || (len == latest_len && strcmp(rel->id, entry->latest) < 0);
+}
+
+bool release_check(const char *cache_path, const char *core, char **githubUrls, int asset,
+      bool installed, long ttl, struct cache_entry *entry)
+{
+   struct release_validators validators = {{0}}, mirror_validators = {{0}};
+   enum release_status status;
+   struct release rel;
+   time_t now = time(NULL);
+   long long checked;
+   int lock = cache_lock(cache_path);
+   int event;
+
+   cache_load(cache_path, core, entry);
+   cache_unlock(lock);
+
+   // Another launch, possibly from another RetroArch instance, checked recently.
+   if (installed && entry->latest[0] != '\0' && now - entry->checked < ttl) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Release metadata checked %llds ago, skipping update check.\n",
+            (long long)(now - entry->checked));
+      return true;
+   }
+
+   // Revalidate against the last response, a first download always needs the full document.
+   if (installed && entry->url[0] != '\0' && entry->latest[0] != '\0') {
+      snprintf(validators.etag, sizeof(validators.etag), "%s", entry->etag);
+      snprintf(validators.last_modified, sizeof(validators.last_modified), "%s", entry->last_modified);
+      snprintf(mirror_validators.etag, sizeof(mirror_validators.etag), "%s", entry->mirror_etag);
+      snprintf(mirror_validators.last_modified, sizeof(mirror_validators.last_modified), "%s", entry->mirror_last_modified);
+   }
+
+   checked = entry->checked;
+   event = trace_begin("release check");
+   rel.mirrored = false;
+   status = release_fetch(githubUrls[0], githubUrls[1], asset, &rel, &validators, &mirror_validators);
+   trace_end(event);
+
+   if (status == RELEASE_FAILED) {
+      return false;
+   }
+
+   // Without the lock while the network was used, other launches may have stored the cache since.
+   lock = cache_lock(cache_path);
+   cache_load(cache_path, core, entry);
+
+   // Checked by another launch in the meantime, its answer is as recent as this one.
+   if (entry->checked != checked) {
+      cache_unlock(lock);
+      return true;
+   }
+
+   if (status == RELEASE_FETCHED && rel.mirrored) {
+      snprintf(entry->mirror_etag, sizeof(entry->mirror_etag), "%s", mirror_validators.etag);
+      snprintf(entry->mirror_last_modified, sizeof(entry->mirror_last_modified), "%s", mirror_validators.last_modified);
+   } else if (status == RELEASE_FETCHED) {
+      snprintf(entry->etag, sizeof(entry->etag), "%s", validators.etag);
+      snprintf(entry->last_modified, sizeof(entry->last_modified), "%s", validators.last_modified);
+   }
+
+   // A mirror that is behind GitHub would otherwise move the install back.
+   if (status == RELEASE_FETCHED && rel.mirrored && entry->latest[0] != '\0' && strcmp(rel.id, entry->latest) != 0
+         && older(&rel, entry)) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: The mirror has an older release (%s) than the latest known, keeping that.\n",
+            rel.tag);
+      status = RELEASE_NOT_MODIFIED;
+   }
+
+   // On 304 the URL and ID stored by the last full response are still valid.
+   if (status == RELEASE_FETCHED) {
+      snprintf(entry->url, sizeof(entry->url), "%s", rel.url);
+      snprintf(entry->latest, sizeof(entry->latest), "%s", rel.id);
+      snprintf(entry->digest, sizeof(entry->digest), "%s", rel.digest);
+      snprintf(entry->zsync, sizeof(entry->zsync), "%s", rel.zsync);
+      snprintf(entry->published, sizeof(entry->published), "%s", rel.published);
+      entry->size = rel.size;
+   }
+
+   entry->checked = now;
+   cache_store(cache_path, core, entry);
+   cache_unlock(lock);
+   return true;
+}
+
+bool release_update_available(const struct cache_entry *entry)
+{
+   return strcmp(entry->current, entry->latest) != 0 && strcmp(entry->skip, entry->latest) != 0;
+}
+
+bool release_installed(const char *cache_path, const char *core, const char *id)
+{
+   struct cache_entry entry;
+   int lock = cache_lock(cache_path);
+   bool ok;
+
+   cache_load(cache_path, core, &entry);
+   snprintf(entry.current, sizeof(entry.current), "%s", id);
+
+   if (strcmp(entry.staged, id) == 0) {
+      entry.staged[0] = '\0';
+   }
+
+   ok = cache_store(cache_path, core, &entry);
+   cache_unlock(lock);
+   return ok;
+}
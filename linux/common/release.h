@@ -0,0 +1,81 @@
+#ifndef LAUNCHER_RELEASE_H
+#define LAUNCHER_RELEASE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "cache.h"
+
+/**
+ * The release fields the launchers care about, taken from the
+ * GitHub "releases/latest" document in a single pass.
+ */
+struct release {
+   char tag[128];
+   char name[256];
+   char id[32];
+   char url[1024];
+   char digest[80]; // "sha256:<hex>", empty for older releases
+   char zsync[1024]; // URL of the zsync control file of the asset, if published
+   char published[32]; // published_at, ISO 8601 in UTC
+   long long size;
+   bool mirrored; // answered by the release mirror
+};
+
+/**
+ * HTTP validators of the last full response, sent back as
+ * If-None-Match/If-Modified-Since on the next check.
+ */
+struct release_validators {
+   char etag[128];
+   char last_modified[64];
+};
+
+enum release_status {
+   RELEASE_FAILED,
+   RELEASE_FETCHED,
+   RELEASE_NOT_MODIFIED
+};
+
+/**
+ * Parse a release document and pick the asset at index asset.
+ * The download url is built as download_url + tag + "/" + name.
+ */
+bool release_parse(const char *json, size_t len, int asset, const char *download_url, struct release *rel);
+
+/**
+ * Fetch and parse api_url with one request.
+ * If validators is not NULL the request is conditional: an unchanged release
+ * returns RELEASE_NOT_MODIFIED without a body and rel is left untouched.
+ * On RELEASE_FETCHED validators are replaced with the ones of the response.
+ * With LAUNCHER_GITHUB_URL set, for example to http://127.0.0.1:8080, GitHub
+ * URLs go to that server instead, with the same paths. A release mirror,
+ * see mirror.h, is asked before either of them, with mirror_validators.
+ */
+enum release_status release_fetch(const char *api_url, const char *download_url, int asset,
+      struct release *rel, struct release_validators *validators, struct release_validators *mirror_validators);
+
+/**
+ * Refresh the cached release metadata of core, unless it was checked less
+ * than ttl seconds ago. The cache lock is only held to read and update the
+ * cache, not while the network is used, so checks of different cores run
+ * side by side. When another launch stored a check of core in the meantime
+ * its answer is kept. A mirror that is behind never replaces the latest
+ * release with an older one.
+ * On success entry holds the URL, size and digest of the latest asset and
+ * the current and latest asset IDs.
+ */
+bool release_check(const char *cache_path, const char *core, char **githubUrls, int asset,
+      bool installed, long ttl, struct cache_entry *entry);
+
+/**
+ * True if the latest release of entry is neither installed nor the one
+ * rolled back from.
+ */
+bool release_update_available(const struct cache_entry *entry);
+
+/**
+ * Record id as the installed version of core.
+ */
+bool release_installed(const char *cache_path, const char *core, const char *id);
+
+#endif
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "session.h"
+#include "launch.h"
+#include "cgroup.h"
+#include "log.h"
+
+// How long the emulator gets to quit on its own when the session is stopped.
+#define STOP_TIMEOUT 5.0
+#define MAX_ARGS 16
+
+/**
+ * The handoff supervisor, run by sh with the frontend command as $0, the
+ * pid of the frontend as $1 and the emulator command after it. It asks
+ * the frontend to quit, gives it 10 seconds, runs the emulator and then
+ * starts the frontend again, unless it never quit.
+ */
+static const char handoff_script[] =
+      "frontend=$0 pid=$1; shift; kill -TERM \"$pid\"; i=0; "
+      "while kill -0 \"$pid\" 2>/dev/null && [ $i -lt 100 ]; do sleep 0.1; i=$((i + 1)); done; "
+      "\"$@\"; kill -0 \"$pid\" 2>/dev/null || eval \"exec $frontend\"";
+
+static pid_t session_pid = -1;
+static double session_started;
+static double cpu_started;
+static bool idle_requested;
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * CPU time used by the frontend itself, all its threads but no children.
+ */
+static double cpu_time(void)
+{
+   struct rusage usage;
+
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+bool session_start(char *const argv[])
+{
+   if (session_pid > 0) {
+      return false;
+   }
+
+   session_pid = launch_spawn_group(argv);
+   session_started = now();
+   cpu_started = cpu_time();
+   return session_pid > 0;
+}
+
+bool session_active(void)
+{
+   return session_pid > 0;
+}
+
+/**
+ * Reap the emulator if it exited, without blocking.
+ */
+static bool reap(int *status)
+{
+   int wstatus;
+   pid_t pid = waitpid(session_pid, &wstatus, WNOHANG);
+
+   if (pid == 0 || (pid < 0 && errno == EINTR)) {
+      return false;
+   }
+
+   if (pid < 0) {
+      // Reaped by someone else, like a frontend ignoring SIGCHLD.
+      *status = -1;
+   } else if (WIFSIGNALED(wstatus)) {
+      *status = -1;
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: pid %d killed by signal %d\n", (int)session_pid, WTERMSIG(wstatus));
+   } else {
+      *status = WEXITSTATUS(wstatus);
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Session of pid %d ended with status %d after %.1fs\n",
+         (int)session_pid, *status, now() - session_started);
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Frontend CPU during the session: %.1f%%%s\n",
+         100 * (cpu_time() - cpu_started) / (now() - session_started), idle_requested ? " (idle)" : "");
+   cgroup_reaped(session_pid);
+   session_pid = -1;
+   return true;
+}
+
+bool session_exited(int *status)
+{
+   return session_pid > 0 && reap(status);
+}
+
+void session_stop(void)
+{
+   struct timespec pause = { 0, 50 * 1000000L };
+   double deadline = now() + STOP_TIMEOUT;
+   int status;
+
+   if (session_pid <= 0) {
+      return;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Stopping pid %d\n", (int)session_pid);
+
+   // The whole group, AppImages run the emulator in a child of their runtime.
+   kill(-session_pid, SIGTERM);
+
+   while (!reap(&status)) {
+      if (now() > deadline) {
+         launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: pid %d did not quit, killing it.\n", (int)session_pid);
+         kill(-session_pid, SIGKILL);
+         deadline = now() + STOP_TIMEOUT;
+      }
+      nanosleep(&pause, NULL);
+   }
+}
+
+void session_set_idle(bool idle)
+{
+   idle_requested = idle;
+}
+
+bool session_idle(void)
+{
+   return idle_requested && session_pid > 0;
+}
+
+void session_idle_av_info(struct retro_system_av_info *info)
+{
+   // 10 frames a second still notice the emulator exiting right away.
+   info->timing.fps = 10.0;
+   info->geometry.base_width = 64;
+   info->geometry.base_height = 48;
+   info->geometry.max_width = 64;
+   info->geometry.max_height = 48;
+}
+
+/**
+ * Append arg to the command in out, single quoted for sh.
+ */
+static bool append_quoted(char *out, size_t size, const char *arg)
+{
+   size_t len = strlen(out);
+
+   // A space, both quotes and the terminator.
+   if (len + 4 > size) {
+      return false;
+   }
+   if (len > 0) {
+      out[len++] = ' ';
+   }
+
+   for (out[len++] = '\''; *arg != '\0'; arg++) {
+      if (len + 5 >= size) {
+         return false;
+      }
+      if (*arg == '\'') {
+         // Close the quote, an escaped quote, open it again.
+         memcpy(out + len, "'\\''", 4);
+         len += 4;
+      } else {
+         out[len++] = *arg;
+      }
+   }
+
+   if (len + 2 > size) {
+      return false;
+   }
+
+   out[len++] = '\'';
+   out[len] = '\0';
+   return true;
+}
+
+static bool in_list(const char *arg, const char *const list[], size_t count)
+{
+   for (size_t i = 0; i < count; i++) {
+      size_t len = strlen(list[i]);
+
+      if (strncmp(arg, list[i], len) == 0 && (arg[len] == '\0' || (len > 2 && arg[len] == '='))) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/**
+ * The command that starts the frontend again: the same executable, or the
+ * AppImage it runs from, with only the options that select its config and
+ * logging. The content and the core are dropped, they would load the
+ * launcher again.
+ */
+static bool frontend_command(char *out, size_t size)
+{
+   static const char *const with_value[] = { "-c", "--config", "--appendconfig", "--log-file" };
+   static const char *const flags[] = { "-v", "--verbose", "-f", "--fullscreen" };
+   const char *appimage = getenv("APPIMAGE");
+   char cmdline[8192], exe[4096];
+   ssize_t len;
+   int fd;
+
+   out[0] = '\0';
+
+   if (appimage && access(appimage, X_OK) == 0) {
+      snprintf(exe, sizeof(exe), "%s", appimage);
+   } else if ((len = readlink("/proc/self/exe", exe, sizeof(exe) - 1)) > 0) {
+      exe[len] = '\0';
+   } else {
+      return false;
+   }
+
+   if (!append_quoted(out, size, exe) || (fd = open("/proc/self/cmdline", O_RDONLY | O_CLOEXEC)) < 0) {
+      return false;
+   }
+
+   len = read(fd, cmdline, sizeof(cmdline) - 1);
+   close(fd);
+
+   if (len <= 0) {
+      return false;
+   }
+
+   cmdline[len] = '\0';
+
+   // Skip argv[0], exe is used instead.
+   for (char *arg = cmdline + strlen(cmdline) + 1; arg < cmdline + len; arg += strlen(arg) + 1) {
+      char *next = arg + strlen(arg) + 1;
+
+      if (in_list(arg, with_value, 4) && strchr(arg, '=') == NULL && next < cmdline + len) {
+         if (!append_quoted(out, size, arg) || !append_quoted(out, size, next)) {
+            return false;
+         }
+         arg = next;
+      } else if (in_list(arg, with_value, 4) || in_list(arg, flags, 4)) {
+         if (!append_quoted(out, size, arg)) {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+bool session_handoff(char *const argv[])
+{
+   char frontend[8192], pid[16];
+   char *args[MAX_ARGS] = { "/bin/sh", "-c", (char *)handoff_script, frontend, pid };
+   size_t n = 5;
+
+   if (!frontend_command(frontend, sizeof(frontend))) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot tell how to start the frontend again.\n");
+      return false;
+   }
+
+   snprintf(pid, sizeof(pid), "%d", (int)getpid());
+
+   for (size_t i = 0; argv[i] != NULL && n < MAX_ARGS - 1; i++) {
+      args[n++] = argv[i];
+   }
+   args[n] = NULL;
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Handing off to %s, the frontend quits and restarts with %s\n", argv[0], frontend);
+   return launch_spawn_detached(args) > 0;
+}
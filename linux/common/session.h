@@ -0,0 +1,62 @@
+#ifndef LAUNCHER_SESSION_H
+#define LAUNCHER_SESSION_H
+
+#include <stdbool.h>
+#include "libretro.h"
+
+/**
+ * Supervised sessions.
+ *
+ * Instead of blocking retro_load_game() until the emulator exits, the
+ * emulator is started in the background and retro_run() checks on it
+ * every frame without blocking, so the frontend keeps running. The
+ * session ends when the emulator exits, or is stopped by session_stop().
+ */
+bool session_start(char *const argv[]);
+
+/**
+ * True from session_start() until the end of the session was seen by
+ * session_exited() or session_stop().
+ */
+bool session_active(void);
+
+/**
+ * Check, without blocking, whether the emulator exited. If it did, its
+ * exit status, -1 if it was killed, is stored in status and the session
+ * ends. Logs the exit status and how long the session lasted.
+ */
+bool session_exited(int *status);
+
+/**
+ * End the session, asking the emulator to quit and killing it if it
+ * is still running a few seconds later.
+ */
+void session_stop(void);
+
+/**
+ * Idle the frontend during the next session: retro_run() only lets the
+ * frontend repeat its last frame, see session_idle_av_info(). Only for
+ * frontends that can dupe frames.
+ */
+void session_set_idle(bool idle);
+
+/**
+ * True while an idle session runs.
+ */
+bool session_idle(void);
+
+/**
+ * Tiny geometry and a low frame rate for an idle session, so the frontend
+ * spends its time waiting instead of rendering.
+ */
+void session_idle_av_info(struct retro_system_av_info *info);
+
+/**
+ * Hand off to the emulator instead of running it next to the frontend. A
+ * detached supervisor asks the frontend to quit, so its memory and GPU
+ * context are freed, runs the emulator once it is gone and then starts
+ * the frontend again. Nothing of the launcher runs during the session.
+ */
+bool session_handoff(char *const argv[]);
+
+#endif
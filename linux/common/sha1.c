@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "sha1.h"
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void transform(uint32_t state[5], const unsigned char *p)
+{
+   uint32_t w[80], a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+   for (int i = 0; i < 16; i++) {
+      w[i] = ((uint32_t)p[i * 4] << 24) | (p[i * 4 + 1] << 16) | (p[i * 4 + 2] << 8) | p[i * 4 + 3];
+   }
+   for (int i = 16; i < 80; i++) {
+      w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+   }
+
+   for (int i = 0; i < 80; i++) {
+      uint32_t f, k, t;
+
+      if (i < 20) {
+         f = (b & c) | (~b & d);
+         k = 0x5a827999;
+      } else if (i < 40) {
+         f = b ^ c ^ d;
+         k = 0x6ed9eba1;
+      } else if (i < 60) {
+         f = (b & c) | (b & d) | (c & d);
+         k = 0x8f1bbcdc;
+      } else {
+         f = b ^ c ^ d;
+         k = 0xca62c1d6;
+      }
+
+      t = ROL(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = ROL(b, 30);
+      b = a;
+      a = t;
+   }
+
+   state[0] += a;
+   state[1] += b;
+   state[2] += c;
+   state[3] += d;
+   state[4] += e;
+}
+
+bool sha1_file(const char *path, char hex[41])
+{
+   uint32_t state[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+   unsigned char buf[65536 + 128];
+   uint64_t length = 0;
+   size_t used = 0;
+   ssize_t n;
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+   if (fd < 0) {
+      return false;
+   }
+
+   // Keep partial blocks at the start of buf between reads.
+   while ((n = read(fd, buf + used, 65536)) > 0) {
+      size_t full;
+
+      length += n;
+      used += n;
+      full = used - used % 64;
+
+      for (size_t i = 0; i < full; i += 64) {
+         transform(state, buf + i);
+      }
+
+      memmove(buf, buf + full, used - full);
+      used -= full;
+   }
+
+   close(fd);
+
+   if (n < 0) {
+      return false;
+   }
+
+   memset(buf + used, 0, 128 - used);
+   buf[used] = 0x80;
+   used = used < 56 ? 64 : 128;
+
+   for (int i = 0; i < 8; i++) {
+      buf[used - 1 - i] = (length * 8) >> (i * 8);
+   }
+
+   for (size_t i = 0; i < used; i += 64) {
+      transform(state, buf + i);
+   }
+
+   for (int i = 0; i < 5; i++) {
+      snprintf(hex + i * 8, 9, "%08x", state[i]);
+   }
+   return true;
+}
@@ -0,0 +1,11 @@
+#ifndef LAUNCHER_SHA1_H
+#define LAUNCHER_SHA1_H
+
+#include <stdbool.h>
+
+/**
+ * Hash the file at path into a lowercase hex string.
+ */
+bool sha1_file(const char *path, char hex[41]);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef LAUNCHER_SHA256_H
+#define LAUNCHER_SHA256_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct sha256 {
+   uint32_t state[8];
+   uint64_t length;
+   unsigned char block[64];
+   size_t used;
+};
+
+void sha256_init(struct sha256 *ctx);
+void sha256_update(struct sha256 *ctx, const void *data, size_t len);
+void sha256_final(struct sha256 *ctx, unsigned char digest[32]);
+
+/**
+ * Hash the file at path into a lowercase hex string.
+ */
+bool sha256_file(const char *path, char hex[65]);
+
+#endif
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "state.h"
+#include "log.h"
+
+struct launch_state {
+   char executable[1024];
+   char version[32];
+   long long device;
+   long long inode;
+   long long size;
+   long long mtime; // nanoseconds
+   long long validated;
+};
+
+static void state_path(const char *dir, char *path, size_t size)
+{
+   snprintf(path, size, "%.1000s/launch.state", dir);
+}
+
+static long long mtime_ns(const struct stat *st)
+{
+   return st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static bool load(const char *dir, struct launch_state *state)
+{
+   char path[1024], line[1100];
+   FILE *file;
+
+   memset(state, 0, sizeof(*state));
+   state_path(dir, path, sizeof(path));
+
+   if (!(file = fopen(path, "r"))) {
+      return false;
+   }
+
+   while (fgets(line, sizeof(line), file)) {
+      char *value = strchr(line, '=');
+
+      if (!value) {
+         continue;
+      }
+
+      *value++ = '\0';
+      value[strcspn(value, "\n")] = '\0';
+
+      if (strcmp(line, "executable") == 0) {
+         snprintf(state->executable, sizeof(state->executable), "%s", value);
+      } else if (strcmp(line, "version") == 0) {
+         snprintf(state->version, sizeof(state->version), "%s", value);
+      } else if (strcmp(line, "device") == 0) {
+         state->device = strtoll(value, NULL, 10);
+      } else if (strcmp(line, "inode") == 0) {
+         state->inode = strtoll(value, NULL, 10);
+      } else if (strcmp(line, "size") == 0) {
+         state->size = strtoll(value, NULL, 10);
+      } else if (strcmp(line, "mtime") == 0) {
+         state->mtime = strtoll(value, NULL, 10);
+      } else if (strcmp(line, "validated") == 0) {
+         state->validated = strtoll(value, NULL, 10);
+      }
+   }
+
+   fclose(file);
+   return state->executable[0] != '\0';
+}
+
+bool state_fast_path(const char *dir, long ttl, char *executable, size_t size)
+{
+   struct launch_state state;
+   struct stat st;
+   long long age;
+
+   if (!load(dir, &state)) {
+      return false;
+   }
+
+   age = (long long)time(NULL) - state.validated;
+
+   // The one stat of a warm launch, through the current link.
+   if (age < 0 || age >= ttl || stat(state.executable, &st) != 0 || (long long)st.st_dev != state.device
+         || (long long)st.st_ino != state.inode || (long long)st.st_size != state.size || mtime_ns(&st) != state.mtime) {
+      return false;
+   }
+
+   snprintf(executable, size, "%s", state.executable);
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Launching version %s validated %llds ago: %s\n",
+         state.version[0] ? state.version : "unknown", age, executable);
+   return true;
+}
+
+bool state_record(const char *dir, const char *executable)
+{
+   char path[1024], tmp_path[1100], link[1024], current[1100];
+   struct stat st;
+   ssize_t len;
+   FILE *file;
+
+   if (stat(executable, &st) != 0) {
+      return false;
+   }
+
+   // The version is the folder the current link points at.
+   snprintf(current, sizeof(current), "%.1000s/current", dir);
+   len = readlink(current, link, sizeof(link) - 1);
+   link[len > 0 ? len : 0] = '\0';
+
+   state_path(dir, path, sizeof(path));
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+   if (!(file = fopen(tmp_path, "w"))) {
+      return false;
+   }
+
+   fprintf(file, "executable=%s\nversion=%s\ndevice=%lld\ninode=%lld\nsize=%lld\nmtime=%lld\nvalidated=%lld\n",
+         executable, strrchr(link, '/') ? strrchr(link, '/') + 1 : link, (long long)st.st_dev, (long long)st.st_ino,
+         (long long)st.st_size, mtime_ns(&st), (long long)time(NULL));
+
+   if (fclose(file) != 0 || rename(tmp_path, path) != 0) {
+      unlink(tmp_path);
+      return false;
+   }
+
+   return true;
+}
+
+void state_invalidate(const char *dir)
+{
+   char path[1024];
+
+   state_path(dir, path, sizeof(path));
+   unlink(path);
+}
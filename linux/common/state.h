@@ -0,0 +1,33 @@
+#ifndef LAUNCHER_STATE_H
+#define LAUNCHER_STATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Launch state of a core, dir/launch.state.
+ *
+ * After a full launch (folders, executable search, update check) the
+ * executable, its version and what stat() said about it are recorded. A
+ * launch within ttl seconds of that validation, with the executable
+ * unchanged, then only needs to stat it. Changing the current version
+ * changes the stat; staging an update removes the record.
+ */
+
+/**
+ * True, with the recorded executable in executable, if the record in dir
+ * is still valid.
+ */
+bool state_fast_path(const char *dir, long ttl, char *executable, size_t size);
+
+/**
+ * Record executable as validated now.
+ */
+bool state_record(const char *dir, const char *executable);
+
+/**
+ * Drop the record, the next launch takes the full path.
+ */
+void state_invalidate(const char *dir);
+
+#endif
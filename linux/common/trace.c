@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "trace.h"
+#include "log.h"
+
+#define MAX_EVENTS 128
+#define MAX_COUNTERS 16
+
+struct trace_event {
+   const char *name;
+   retro_time_t start;
+   retro_time_t end; // -1 while running
+   long tid;
+   int depth;
+   int counter;
+   bool cut; // still running when the launch ended
+};
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct retro_perf_callback perf;
+// The frontend keeps pointers to registered counters, they live as long as the core.
+static struct retro_perf_counter counters[MAX_COUNTERS];
+static struct trace_event events[MAX_EVENTS];
+static int event_count;
+static int phase = -1;
+// Handles of an earlier launch, from a thread that outlived it, don't match.
+static int generation;
+static bool tracing;
+static long main_tid;
+static char trace_dir[1024];
+
+static long thread_id(void)
+{
+   return (long)syscall(SYS_gettid);
+}
+
+static retro_time_t now(void)
+{
+   struct timespec ts;
+
+   if (perf.get_time_usec) {
+      return perf.get_time_usec();
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int counter_start(const char *name)
+{
+   int i;
+
+   if (!perf.perf_register || !perf.perf_start || !perf.perf_stop) {
+      return -1;
+   }
+
+   for (i = 0; i < MAX_COUNTERS && counters[i].ident; i++) {
+      if (strcmp(counters[i].ident, name) == 0) {
+         break;
+      }
+   }
+
+   if (i == MAX_COUNTERS) {
+      return -1;
+   }
+
+   if (!counters[i].ident) {
+      counters[i].ident = name;
+   }
+
+   if (!counters[i].registered) {
+      perf.perf_register(&counters[i]);
+   }
+
+   perf.perf_start(&counters[i]);
+   return i;
+}
+
+static int record(const char *name, int depth)
+{
+   struct trace_event *e;
+
+   if (!tracing || event_count == MAX_EVENTS) {
+      return -1;
+   }
+
+   e = &events[event_count];
+   e->name = name;
+   e->tid = thread_id();
+   e->depth = depth;
+   e->counter = -1;
+   e->start = now();
+   e->end = -1;
+   e->cut = false;
+   return event_count++;
+}
+
+static void close_event(int i, retro_time_t t)
+{
+   if (events[i].end >= 0) {
+      return;
+   }
+
+   events[i].end = t;
+
+   if (events[i].counter >= 0) {
+      perf.perf_stop(&counters[events[i].counter]);
+   }
+}
+
+void trace_start(retro_environment_t environ_cb)
+{
+   pthread_mutex_lock(&trace_lock);
+   memset(&perf, 0, sizeof(perf));
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_PERF_INTERFACE, &perf) || !perf.get_time_usec) {
+      memset(&perf, 0, sizeof(perf));
+   }
+
+   event_count = 0;
+   phase = -1;
+   generation++;
+   trace_dir[0] = '\0';
+   main_tid = thread_id();
+   tracing = true;
+   pthread_mutex_unlock(&trace_lock);
+}
+
+void trace_set_file(const char *dir)
+{
+   pthread_mutex_lock(&trace_lock);
+   snprintf(trace_dir, sizeof(trace_dir), "%.1000s/traces", dir);
+   pthread_mutex_unlock(&trace_lock);
+}
+
+void trace_phase(const char *name)
+{
+   pthread_mutex_lock(&trace_lock);
+
+   if (phase >= 0) {
+      close_event(phase, now());
+   }
+
+   phase = record(name, 0);
+
+   if (phase >= 0) {
+      events[phase].counter = counter_start(name);
+   }
+
+   pthread_mutex_unlock(&trace_lock);
+}
+
+int trace_begin(const char *name)
+{
+   long tid = thread_id();
+   int depth = 0, event;
+
+   pthread_mutex_lock(&trace_lock);
+
+   // Nested in whatever the same thread has open.
+   for (int i = 0; i < event_count; i++) {
+      if (events[i].tid == tid && events[i].end < 0) {
+         depth++;
+      }
+   }
+
+   event = record(name, depth);
+   pthread_mutex_unlock(&trace_lock);
+   return event < 0 ? -1 : generation * MAX_EVENTS + event;
+}
+
+void trace_end(int event)
+{
+   pthread_mutex_lock(&trace_lock);
+
+   if (tracing && event >= 0 && event / MAX_EVENTS == generation && event % MAX_EVENTS < event_count) {
+      close_event(event % MAX_EVENTS, now());
+   }
+
+   pthread_mutex_unlock(&trace_lock);
+}
+
+static void write_file(retro_time_t base)
+{
+   char path[1200], stamp[32];
+   time_t t = time(NULL);
+   struct tm tm;
+   FILE *file = NULL;
+   int fd = -1;
+
+   mkdir(trace_dir, 0755);
+   localtime_r(&t, &tm);
+   strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+   // Launches within the same second, from a retry or another frontend, get -2, -3 and so on.
+   for (int n = 1; fd < 0 && n <= 100; n++) {
+      if (n == 1) {
+         snprintf(path, sizeof(path), "%s/launch-%s.json", trace_dir, stamp);
+      } else {
+         snprintf(path, sizeof(path), "%s/launch-%s-%d.json", trace_dir, stamp, n);
+      }
+
+      if ((fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)) < 0 && errno != EEXIST) {
+         break;
+      }
+   }
+
+   if (fd < 0 || !(file = fdopen(fd, "w"))) {
+      if (fd >= 0) {
+         close(fd);
+      }
+      launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Cannot write the launch trace %s\n", path);
+      return;
+   }
+
+   fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+   fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"retro_load_game\"}}",
+         (long)getpid(), main_tid);
+
+   // Complete events, the names are literals of the launcher code and need no escaping.
+   for (int i = 0; i < event_count; i++) {
+      fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%ld,\"tid\":%ld}",
+            events[i].name, events[i].tid == main_tid && events[i].depth == 0 ? "phase" : "step", (long long)(events[i].start - base),
+            (long long)(events[i].end - events[i].start), (long)getpid(), events[i].tid);
+   }
+
+   fprintf(file, "\n]}\n");
+
+   if (fclose(file) == 0) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Launch trace written to %s\n", path);
+   }
+}
+
+void trace_finish(void)
+{
+   retro_time_t t;
+
+   pthread_mutex_lock(&trace_lock);
+
+   if (!tracing || event_count == 0) {
+      tracing = false;
+      pthread_mutex_unlock(&trace_lock);
+      return;
+   }
+
+   t = now();
+
+   if (phase >= 0) {
+      close_event(phase, t);
+   }
+
+   // Steps of the background update that are still running end here in the trace.
+   for (int i = 0; i < event_count; i++) {
+      if (events[i].end < 0) {
+         events[i].end = t;
+         events[i].cut = true;
+      }
+   }
+
+   tracing = false;
+   pthread_mutex_unlock(&trace_lock);
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Launch phases, %.1f ms in all (%s):\n",
+         (t - events[0].start) / 1000.0, perf.get_time_usec ? "frontend perf interface" : "monotonic clock");
+
+   for (int i = 0; i < event_count; i++) {
+      int depth = events[i].depth;
+
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: %*s%-*s %10.1f ms%s\n", 2 + 2 * depth, "", 24 - 2 * depth,
+            events[i].name, (events[i].end - events[i].start) / 1000.0,
+            events[i].cut ? " (still running)" : events[i].tid != main_tid ? " (background)" : "");
+   }
+
+   if (trace_dir[0] != '\0') {
+      write_file(events[0].start);
+   }
+}
@@ -0,0 +1,45 @@
+#ifndef LAUNCHER_TRACE_H
+#define LAUNCHER_TRACE_H
+
+#include <stdbool.h>
+#include "libretro.h"
+
+/**
+ * Launch tracing.
+ *
+ * A launch is a sequence of phases, each starting where the previous one
+ * ended, from retro_load_game() until the emulator exits. The shared code
+ * records the slower steps inside them as nested events, from any thread.
+ * Times come from the perf interface of the frontend when it has one,
+ * which also gets a perf counter per phase, and from the monotonic clock
+ * otherwise. When the launch ends a summary of the phases is logged and,
+ * after trace_set_file(), a Chrome trace event file is written for
+ * chrome://tracing or ui.perfetto.dev.
+ */
+void trace_start(retro_environment_t environ_cb);
+
+/**
+ * Write the trace of this launch to dir/traces/launch-<time>.json, with
+ * a -2, -3 and so on suffix for more launches within the same second.
+ */
+void trace_set_file(const char *dir);
+
+/**
+ * End the current phase and start the next one.
+ */
+void trace_phase(const char *name);
+
+/**
+ * Start a nested event, returns the handle for trace_end(). name must
+ * stay valid until trace_finish(), a string literal.
+ */
+int trace_begin(const char *name);
+void trace_end(int event);
+
+/**
+ * End the last phase, log the summary and write the trace file. Nothing
+ * happens after the first call of a launch.
+ */
+void trace_finish(void);
+
+#endif
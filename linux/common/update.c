@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "update.h"
+#include "cache.h"
+#include "http.h"
+#include "release.h"
+#include "state.h"
+#include "log.h"
+
+struct update_job {
+   char cache_path[1024];
+   char core[32];
+   char api_url[512];
+   char download_url[512];
+   char dir[1024];
+   char file[256];
+   struct install_layout layout;
+   int asset;
+   long ttl;
+};
+
+static pthread_t worker;
+static bool worker_running;
+static struct update_job job;
+
+enum update_result update_stage(const char *cache_path, const char *core, char **githubUrls, int asset,
+      long ttl, const char *dir, const struct install_layout *layout)
+{
+   struct cache_entry entry;
+   int lock;
+
+   if (!release_check(cache_path, core, githubUrls, asset, true, ttl, &entry)) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: %s: update check failed.\n", core);
+      return UPDATE_FAILED;
+   }
+
+   if (!release_update_available(&entry)) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: %s: no update found.\n", core);
+      return UPDATE_CURRENT;
+   }
+
+   if (strcmp(entry.staged, entry.latest) == 0) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: %s: update already staged for the next launch.\n", core);
+      return UPDATE_STAGED;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: %s: update found, downloading it.\n", core);
+
+   if (!install_download(&entry, dir, layout)) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: %s: update not finished, it will be resumed later.\n", core);
+      return UPDATE_FAILED;
+   }
+
+   lock = cache_lock(cache_path);
+   cache_load(cache_path, core, &entry);
+   snprintf(entry.staged, sizeof(entry.staged), "%s", entry.latest);
+   cache_store(cache_path, core, &entry);
+   cache_unlock(lock);
+
+   // The next launch has to take the full path to promote it.
+   state_invalidate(dir);
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: %s: update staged, it will be installed on the next launch.\n", core);
+   return UPDATE_STAGED;
+}
+
+static void *update_worker(void *arg)
+{
+   char *urls[] = { job.api_url, job.download_url };
+
+   (void)arg;
+   update_stage(job.cache_path, job.core, urls, job.asset, job.ttl, job.dir, &job.layout);
+   return NULL;
+}
+
+bool update_start(const char *cache_path, const char *core, char **githubUrls, int asset,
+      long ttl, const char *dir, const struct install_layout *layout)
+{
+   if (worker_running) {
+      return false;
+   }
+
+   memset(&job, 0, sizeof(job));
+   snprintf(job.cache_path, sizeof(job.cache_path), "%s", cache_path);
+   snprintf(job.core, sizeof(job.core), "%s", core);
+   snprintf(job.api_url, sizeof(job.api_url), "%s", githubUrls[0]);
+   snprintf(job.download_url, sizeof(job.download_url), "%s", githubUrls[1]);
+   snprintf(job.dir, sizeof(job.dir), "%s", dir);
+   job.layout = *layout;
+   job.asset = asset;
+   job.ttl = ttl;
+
+   // The worker outlives the caller's strings.
+   if (layout->file) {
+      snprintf(job.file, sizeof(job.file), "%s", layout->file);
+      job.layout.file = job.file;
+   }
+
+   http_cancel(false);
+
+   if (pthread_create(&worker, NULL, update_worker, NULL) != 0) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot start background update.\n");
+      return false;
+   }
+
+   worker_running = true;
+   return true;
+}
+
+void update_stop(void)
+{
+   if (!worker_running) {
+      return;
+   }
+
+   http_cancel(true);
+   pthread_join(worker, NULL);
+   http_cancel(false);
+   worker_running = false;
+}
+
+bool update_promote(const char *cache_path, const char *core, const char *dir, const struct install_layout *layout)
+{
+   struct cache_entry entry;
+   bool promoted = false;
+   int lock = cache_lock(cache_path);
+
+   cache_load(cache_path, core, &entry);
+   install_adopt(dir, entry.current, layout);
+
+   if (entry.staged[0] != '\0') {
+      promoted = install_activate(dir, entry.staged);
+
+      if (promoted) {
+         snprintf(entry.current, sizeof(entry.current), "%s", entry.staged);
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Installed update staged during the last session.\n");
+      }
+
+      entry.staged[0] = '\0';
+      cache_store(cache_path, core, &entry);
+   }
+
+   install_collect(dir, &entry);
+   cache_unlock(lock);
+   return promoted;
+}
+
+bool update_rollback(const char *cache_path, const char *core)
+{
+   struct cache_entry entry;
+   char previous[32];
+   bool ok = false;
+   int lock = cache_lock(cache_path);
+
+   cache_load(cache_path, core, &entry);
+
+   if (entry.path[0] == '\0' || !install_previous(entry.path, previous, sizeof(previous))) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: %s: no previous version to roll back to.\n", core);
+   } else if ((ok = install_activate(entry.path, previous))) {
+      // Rolling back from an older version still keeps the latest release away.
+      snprintf(entry.skip, sizeof(entry.skip), "%s", entry.latest[0] ? entry.latest : entry.current);
+      snprintf(entry.current, sizeof(entry.current), "%s", previous);
+      entry.staged[0] = '\0';
+      ok = cache_store(cache_path, core, &entry);
+   }
+
+   cache_unlock(lock);
+   return ok;
+}
+
+bool update_register(const char *cache_path, const char *core, char **githubUrls, int asset,
+      const char *dir, const struct install_layout *layout)
+{
+   const char *file = layout->file ? layout->file : "";
+   const char *archive = layout->file ? "" : archive_format_name(layout->format);
+   struct cache_entry entry;
+   bool ok = true;
+   int lock;
+
+   // Unlocked first look, the common case is that nothing changed.
+   cache_load(cache_path, core, &entry);
+
+   if (strcmp(entry.api_url, githubUrls[0]) == 0 && strcmp(entry.download_url, githubUrls[1]) == 0
+         && entry.asset == asset && strcmp(entry.path, dir) == 0 && strcmp(entry.file, file) == 0
+         && strcmp(entry.archive, archive) == 0 && entry.strip == layout->strip) {
+      return true;
+   }
+
+   lock = cache_lock(cache_path);
+   cache_load(cache_path, core, &entry);
+   snprintf(entry.api_url, sizeof(entry.api_url), "%s", githubUrls[0]);
+   snprintf(entry.download_url, sizeof(entry.download_url), "%s", githubUrls[1]);
+   entry.asset = asset;
+   snprintf(entry.path, sizeof(entry.path), "%s", dir);
+   snprintf(entry.file, sizeof(entry.file), "%s", file);
+   snprintf(entry.archive, sizeof(entry.archive), "%s", archive);
+   entry.strip = layout->strip;
+   ok = cache_store(cache_path, core, &entry);
+   cache_unlock(lock);
+   return ok;
+}
+
+bool update_layout(const struct cache_entry *entry, struct install_layout *layout)
+{
+   memset(layout, 0, sizeof(*layout));
+   layout->strip = entry->strip;
+
+   if (entry->file[0] != '\0') {
+      layout->file = entry->file;
+      return true;
+   }
+
+   for (int format = ARCHIVE_ZIP; format <= ARCHIVE_TAR_XZ; format++) {
+      if (strcmp(entry->archive, archive_format_name(format)) == 0) {
+         layout->format = format;
+         return true;
+      }
+   }
+   return false;
+}
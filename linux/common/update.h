@@ -0,0 +1,63 @@
+#ifndef LAUNCHER_UPDATE_H
+#define LAUNCHER_UPDATE_H
+
+#include <stdbool.h>
+#include "install.h"
+
+/**
+ * Background ("stale-while-revalidate") updates.
+ *
+ * The installed emulator is launched right away while a worker thread checks
+ * for a newer release and downloads it to its own version folder in dir.
+ * The staged version is activated by update_promote() on the next launch.
+ */
+bool update_start(const char *cache_path, const char *core, char **githubUrls, int asset,
+      long ttl, const char *dir, const struct install_layout *layout);
+
+enum update_result {
+   UPDATE_FAILED,
+   UPDATE_CURRENT,
+   UPDATE_STAGED
+};
+
+/**
+ * Check core for a newer release and download it next to the installed
+ * version, blocking until done. This is the work of the background update
+ * thread, also run by the batch updater for every registered core.
+ */
+enum update_result update_stage(const char *cache_path, const char *core, char **githubUrls, int asset,
+      long ttl, const char *dir, const struct install_layout *layout);
+
+/**
+ * Cancel an unfinished background update and wait for its thread.
+ */
+void update_stop(void);
+
+/**
+ * Activate a version staged by a previous background update and record it
+ * as installed, then collect old versions. An AppImage installed before
+ * versioned installs is moved to its version folder first.
+ * Returns true if a new version was activated.
+ */
+bool update_promote(const char *cache_path, const char *core, const char *dir, const struct install_layout *layout);
+
+/**
+ * Activate the version installed before the current one, without a
+ * download. The latest release is skipped by later updates, until a newer one is out.
+ */
+bool update_rollback(const char *cache_path, const char *core);
+
+/**
+ * Record the release source, install folder and layout of core in the
+ * cache, so the batch updater can update it without the launcher. Only
+ * writes the cache when something changed.
+ */
+bool update_register(const char *cache_path, const char *core, char **githubUrls, int asset,
+      const char *dir, const struct install_layout *layout);
+
+/**
+ * Layout of a core recorded by update_register().
+ */
+bool update_layout(const struct cache_entry *entry, struct install_layout *layout);
+
+#endif
@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "wine.h"
+#include "cache.h"
+#include "release.h"
+#include "launch.h"
+#include "log.h"
+#include "trace.h"
+
+// How long the wineserver stays after the last Wine process, so the next launch finds it running.
+#define SERVER_PERSIST "-p600"
+// The open file limit esync needs, one eventfd per synchronization object.
+#define ESYNC_FILES 524288
+
+/**
+ * What a prefix was set up with, as recorded in its stamp file.
+ */
+struct wine_stamp {
+   char wine[64];
+   char dxvk[32];
+   char vkd3d[32];
+};
+
+static char *dxvk_urls[] = {
+   "https://api.github.com/repos/doitsujin/dxvk/releases/latest",
+   "https://github.com/doitsujin/dxvk/releases/download/"
+};
+
+static char *vkd3d_urls[] = {
+   "https://api.github.com/repos/HansKristian-Work/vkd3d-proton/releases/latest",
+   "https://github.com/HansKristian-Work/vkd3d-proton/releases/download/"
+};
+
+static char wine_dir[1024];
+static pid_t server_pid = -1;
+static double server_started;
+static long long cache_before = -1;
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool read_stamp(const char *path, struct wine_stamp *stamp)
+{
+   FILE *file = fopen(path, "r");
+   char line[128];
+
+   memset(stamp, 0, sizeof(*stamp));
+
+   if (!file) {
+      return false;
+   }
+
+   while (fgets(line, sizeof(line), file)) {
+      char *value = strchr(line, '=');
+
+      if (!value) {
+         continue;
+      }
+
+      *value++ = '\0';
+      value[strcspn(value, "\n")] = '\0';
+
+      if (strcmp(line, "wine") == 0) {
+         snprintf(stamp->wine, sizeof(stamp->wine), "%s", value);
+      } else if (strcmp(line, "dxvk") == 0) {
+         snprintf(stamp->dxvk, sizeof(stamp->dxvk), "%s", value);
+      } else if (strcmp(line, "vkd3d") == 0) {
+         snprintf(stamp->vkd3d, sizeof(stamp->vkd3d), "%s", value);
+      }
+   }
+
+   fclose(file);
+   return true;
+}
+
+static bool write_stamp(const char *path, const struct wine_stamp *stamp)
+{
+   char tmp_path[1100];
+   FILE *file;
+
+   snprintf(tmp_path, sizeof(tmp_path), "%.1000s.tmp", path);
+
+   if (!(file = fopen(tmp_path, "w"))) {
+      return false;
+   }
+
+   fprintf(file, "wine=%s\ndxvk=%s\nvkd3d=%s\n", stamp->wine, stamp->dxvk, stamp->vkd3d);
+
+   if (fclose(file) != 0 || rename(tmp_path, path) != 0) {
+      unlink(tmp_path);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * Latest release ID of a component, or the recorded one when the check fails,
+ * so a prefix is not set up again just because the network is down.
+ */
+static void latest_release(const char *cache_path, const char *name, char **urls, long ttl,
+      const char *recorded, char *id, size_t size)
+{
+   struct cache_entry entry;
+
+   if (release_check(cache_path, name, urls, 0, recorded[0] != '\0', ttl, &entry) && entry.latest[0] != '\0') {
+      snprintf(id, size, "%s", entry.latest);
+   } else {
+      snprintf(id, size, "%s", recorded);
+   }
+}
+
+/**
+ * The documents of the emulator were kept in the default prefix before it
+ * had one of its own, link them into the new one.
+ */
+static void adopt_documents(const char *prefix)
+{
+   const char *home = getenv("HOME"), *user = getenv("USER");
+   char old_path[1100], new_path[1100];
+   struct stat st;
+
+   if (!home || !user) {
+      return;
+   }
+
+   snprintf(old_path, sizeof(old_path), "%.512s/.wine/drive_c/users/%.64s/Documents", home, user);
+   snprintf(new_path, sizeof(new_path), "%.900s/drive_c/users/%.64s/Documents", prefix, user);
+
+   if (stat(old_path, &st) != 0 || !S_ISDIR(st.st_mode) || lstat(new_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+      return;
+   }
+
+   // wineboot creates an empty one, keep it if something was saved into it already.
+   if (rmdir(new_path) == 0 && symlink(old_path, new_path) == 0) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Linked %s into the prefix.\n", old_path);
+   }
+}
+
+/**
+ * A prefix set up before still works with what it was set up with. Keep
+ * using it, and its stamp, so the next launch tries again.
+ */
+static bool setup_failed(bool fresh, const char *step)
+{
+   if (fresh) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: %s failed.\n", step);
+      return false;
+   }
+
+   launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: %s failed, launching with the prefix as it was.\n", step);
+   return true;
+}
+
+bool wine_prepare(const char *dir, long ttl)
+{
+   char *version_argv[] = { "wine", "--version", NULL };
+   char *boot_argv[] = { "wineboot", "-u", NULL };
+   char *tricks_argv[] = { "winetricks", "-q", "--force", "dxvk", "vkd3d", NULL };
+   char prefix[1024], stamp_path[1100], cache_path[1100];
+   struct wine_stamp recorded, wanted;
+   bool fresh;
+   double start;
+
+   snprintf(wine_dir, sizeof(wine_dir), "%s", dir);
+   snprintf(prefix, sizeof(prefix), "%.1000s/wine", dir);
+   snprintf(stamp_path, sizeof(stamp_path), "%.1000s/launcher.stamp", prefix);
+   // Not the shared metadata cache, the batch updater has nothing to do with these.
+   snprintf(cache_path, sizeof(cache_path), "%.1000s/wine.cache", dir);
+
+   launch_setenv("WINEPREFIX", prefix);
+
+   if (launch_output(version_argv, wanted.wine, sizeof(wanted.wine)) != 0 || wanted.wine[0] == '\0') {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Cannot run wine.\n");
+      return false;
+   }
+
+   fresh = !read_stamp(stamp_path, &recorded);
+   latest_release(cache_path, "dxvk", dxvk_urls, ttl, recorded.dxvk, wanted.dxvk, sizeof(wanted.dxvk));
+   latest_release(cache_path, "vkd3d-proton", vkd3d_urls, ttl, recorded.vkd3d, wanted.vkd3d, sizeof(wanted.vkd3d));
+
+   if (!fresh && strcmp(recorded.wine, wanted.wine) == 0 && strcmp(recorded.dxvk, wanted.dxvk) == 0
+         && strcmp(recorded.vkd3d, wanted.vkd3d) == 0) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Wine prefix %s is up to date (%s).\n", prefix, wanted.wine);
+      return true;
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Setting up Wine prefix %s for %s, DXVK release %s and vkd3d-proton release %s\n",
+         prefix, wanted.wine, wanted.dxvk, wanted.vkd3d);
+   start = now();
+   mkdir(dir, 0755);
+
+   if (launch_run_quiet(NULL, boot_argv) != 0) {
+      return setup_failed(fresh, "wineboot");
+   }
+
+   if (fresh) {
+      adopt_documents(prefix);
+   }
+
+   // Without a new stamp the next launch tries again.
+   if (launch_run_quiet(NULL, tricks_argv) != 0) {
+      return setup_failed(fresh, "winetricks dxvk vkd3d");
+   }
+
+   if (!write_stamp(stamp_path, &wanted)) {
+      launcher_log(RETRO_LOG_WARN, "[LAUNCHER-WARN]: Cannot write %s\n", stamp_path);
+   }
+
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Wine prefix ready in %.1fs\n", now() - start);
+   return true;
+}
+
+bool wine_reuse(const char *dir)
+{
+   char prefix[1024], stamp_path[1100];
+
+   snprintf(wine_dir, sizeof(wine_dir), "%s", dir);
+   snprintf(prefix, sizeof(prefix), "%.1000s/wine", dir);
+   snprintf(stamp_path, sizeof(stamp_path), "%.1000s/launcher.stamp", prefix);
+
+   if (access(stamp_path, F_OK) != 0) {
+      return false;
+   }
+
+   launch_setenv("WINEPREFIX", prefix);
+   return true;
+}
+
+/**
+ * The socket of a running wineserver, named after the device and inode of
+ * the prefix.
+ */
+static bool server_running(const char *prefix)
+{
+   char path[128];
+   struct stat st;
+
+   if (stat(prefix, &st) != 0) {
+      return false;
+   }
+
+   snprintf(path, sizeof(path), "/tmp/.wine-%u/server-%llx-%llx/socket",
+         (unsigned)getuid(), (unsigned long long)st.st_dev, (unsigned long long)st.st_ino);
+   return access(path, F_OK) == 0;
+}
+
+void wine_start_server(const char *dir)
+{
+   char *argv[] = { "wineserver", SERVER_PERSIST, NULL };
+   char prefix[1100], stamp_path[1200];
+
+   snprintf(wine_dir, sizeof(wine_dir), "%s", dir);
+   snprintf(prefix, sizeof(prefix), "%.1000s/wine", dir);
+   snprintf(stamp_path, sizeof(stamp_path), "%.1100s/launcher.stamp", prefix);
+
+   // A prefix that is not set up yet gets its server from wineboot.
+   if (access(stamp_path, F_OK) != 0) {
+      return;
+   }
+
+   if (server_running(prefix)) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: wineserver for %s is running already.\n", prefix);
+      return;
+   }
+
+   launch_setenv("WINEPREFIX", prefix);
+   server_started = now();
+   server_pid = launch_spawn_quiet(argv);
+}
+
+void wine_stop_server(void)
+{
+   char *argv[] = { "wineserver", "-k", NULL };
+
+   if (server_pid <= 0) {
+      return;
+   }
+
+   // It exits once the server it forked into the background is up, that one gets -k.
+   launch_wait(server_pid);
+   server_pid = -1;
+   launch_run_quiet(NULL, argv);
+}
+
+static void set_default(const char *name, const char *value)
+{
+   if (getenv(name) == NULL) {
+      launch_setenv(name, value);
+   }
+}
+
+/**
+ * Size of the files in the shader cache folders.
+ */
+static long long cache_size(void)
+{
+   static const char *const folders[] = { "dxvk", "vkd3d" };
+   long long size = 0;
+
+   for (size_t i = 0; i < 2; i++) {
+      char path[1200];
+      struct dirent *e;
+      DIR *d;
+
+      snprintf(path, sizeof(path), "%.1000s/shader-cache/%s", wine_dir, folders[i]);
+
+      if (!(d = opendir(path))) {
+         continue;
+      }
+
+      while ((e = readdir(d)) != NULL) {
+         struct stat st;
+
+         if (fstatat(dirfd(d), e->d_name, &st, 0) == 0 && S_ISREG(st.st_mode)) {
+            size += st.st_size;
+         }
+      }
+      closedir(d);
+   }
+
+   return size;
+}
+
+static const char *sync_environment(void)
+{
+   struct rlimit files;
+
+   if (getenv("WINEFSYNC") || getenv("WINEESYNC")) {
+      return "as set by the user";
+   }
+
+   // Recent Wine uses the ntsync driver by itself, it beats both.
+   if (access("/dev/ntsync", F_OK) == 0) {
+      return "ntsync";
+   }
+
+#ifdef SYS_futex_waitv
+   // Linux 5.16 and later, an empty wait is rejected instead of unknown.
+   if (syscall(SYS_futex_waitv, NULL, 0, 0, NULL, 0) == 0 || errno != ENOSYS) {
+      launch_setenv("WINEFSYNC", "1");
+      return "fsync";
+   }
+#endif
+
+   if (getrlimit(RLIMIT_NOFILE, &files) == 0 && (files.rlim_max == RLIM_INFINITY || files.rlim_max >= ESYNC_FILES)) {
+      launch_setenv("WINEESYNC", "1");
+      return "esync";
+   }
+
+   return "wineserver";
+}
+
+void wine_ready(void)
+{
+   char path[1200];
+
+   if (server_pid > 0) {
+      // The server forks into the background once its socket is up.
+      double waited = now();
+      int event = trace_begin("wineserver wait");
+      int status = launch_wait(server_pid);
+
+      trace_end(event);
+
+      if (status == 0) {
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: wineserver ready %.0f ms after it was started, waited %.0f ms for it.\n",
+               (now() - server_started) * 1000, (now() - waited) * 1000);
+      }
+      server_pid = -1;
+   }
+
+   set_default("WINEDEBUG", "-all");
+
+   snprintf(path, sizeof(path), "%.1000s/shader-cache", wine_dir);
+   mkdir(path, 0755);
+   snprintf(path, sizeof(path), "%.1000s/shader-cache/dxvk", wine_dir);
+   mkdir(path, 0755);
+   set_default("DXVK_STATE_CACHE_PATH", path);
+   // Only honored by DXVK builds with asynchronous pipeline compilation.
+   set_default("DXVK_ASYNC", "1");
+   snprintf(path, sizeof(path), "%.1000s/shader-cache/vkd3d", wine_dir);
+   mkdir(path, 0755);
+   set_default("VKD3D_SHADER_CACHE_PATH", path);
+
+   cache_before = cache_size();
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Wine synchronization: %s, shader caches: %.1f MB\n",
+         sync_environment(), cache_before / 1048576.0);
+}
+
+void wine_report(void)
+{
+   long long after;
+
+   if (cache_before < 0) {
+      return;
+   }
+
+   after = cache_size();
+   launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Shader caches grew by %.1f MB to %.1f MB, compiled while playing.\n",
+         (after - cache_before) / 1048576.0, after / 1048576.0);
+   cache_before = -1;
+}
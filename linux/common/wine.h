@@ -0,0 +1,53 @@
+#ifndef LAUNCHER_WINE_H
+#define LAUNCHER_WINE_H
+
+#include <stdbool.h>
+
+/**
+ * Wine prefix of a launcher.
+ *
+ * Launchers of Windows emulators run them in a prefix of their own, dir/wine,
+ * set up once with wineboot and winetricks dxvk vkd3d. The Wine version and
+ * the DXVK and vkd3d-proton releases it was set up with are recorded in a
+ * stamp file, and it is only set up again when one of them changes. The
+ * releases are checked at most every ttl seconds, like the emulator itself.
+ * Sets WINEPREFIX for the emulator. False without a usable Wine, or when a
+ * new prefix cannot be set up; a failed update of one keeps it as it was.
+ */
+bool wine_prepare(const char *dir, long ttl);
+
+/**
+ * Use the prefix in dir as it was set up, without running wine or checking
+ * the releases, for warm launches within the update check interval. Sets
+ * WINEPREFIX. False if it was never set up, wine_prepare() is needed then.
+ */
+bool wine_reuse(const char *dir);
+
+/**
+ * Start a persistent wineserver for the prefix of an earlier wine_prepare()
+ * in dir, so it is up by the time the emulator starts and the next launch
+ * finds it still running. Call before the update check.
+ */
+void wine_start_server(const char *dir);
+
+/**
+ * Reap and stop the wineserver of wine_start_server() when the launch
+ * failed before wine_ready(). Nothing happens after wine_ready().
+ */
+void wine_stop_server(void);
+
+/**
+ * Wait for the wineserver of wine_start_server() and set the launch
+ * environment: esync or fsync where the kernel supports them, no Wine
+ * debug channels, and DXVK and vkd3d-proton caches next to the prefix.
+ * Variables already set by the user are kept.
+ */
+void wine_ready(void);
+
+/**
+ * Log how much the shader caches grew while the emulator ran. Shaders
+ * compiled during play are what makes it stutter, the next launch reuses them.
+ */
+void wine_report(void);
+
+#endif
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "zsync.h"
+#include "http.h"
+#include "md4.h"
+#include "sha1.h"
+#include "log.h"
+
+// Missing blocks closer than this are fetched as one range.
+#define MAX_GAP (64 * 1024)
+
+/**
+ * Header of a zsync control file, followed by one rsum and MD4 prefix per block.
+ */
+struct zsync_control {
+   size_t blocksize;
+   long long length;
+   int seq_matches;
+   int rsum_bytes;
+   int checksum_bytes;
+   char sha1[41];
+   size_t blocks;
+   const unsigned char *sums;
+};
+
+struct target {
+   uint32_t key;
+   uint32_t next; // chain in the hash table, 0 ends it
+   unsigned char checksum[16];
+};
+
+struct seed {
+   const unsigned char *data;
+   size_t len;
+};
+
+struct rsum {
+   uint16_t a;
+   uint16_t b;
+};
+
+static bool parse_control(const char *data, size_t len, struct zsync_control *zc)
+{
+   const char *p = data, *end = data + len;
+
+   memset(zc, 0, sizeof(*zc));
+
+   // "Key: value" lines up to an empty line.
+   while (p < end) {
+      const char *eol = memchr(p, '\n', end - p);
+
+      if (!eol) {
+         return false;
+      }
+      if (eol == p) {
+         p++;
+         break;
+      }
+
+      if (strncmp(p, "Blocksize: ", 11) == 0) {
+         zc->blocksize = strtoul(p + 11, NULL, 10);
+      } else if (strncmp(p, "Length: ", 8) == 0) {
+         zc->length = strtoll(p + 8, NULL, 10);
+      } else if (strncmp(p, "Hash-Lengths: ", 14) == 0) {
+         sscanf(p + 14, "%d,%d,%d", &zc->seq_matches, &zc->rsum_bytes, &zc->checksum_bytes);
+      } else if (strncmp(p, "SHA-1: ", 7) == 0 && eol - p >= 47) {
+         snprintf(zc->sha1, sizeof(zc->sha1), "%.40s", p + 7);
+      }
+      p = eol + 1;
+   }
+
+   if (zc->blocksize < 16 || (zc->blocksize & (zc->blocksize - 1)) != 0 || zc->length <= 0
+         || zc->seq_matches < 1 || zc->seq_matches > 2 || zc->rsum_bytes < 1 || zc->rsum_bytes > 4
+         || zc->checksum_bytes < 3 || zc->checksum_bytes > 16) {
+      return false;
+   }
+
+   zc->blocks = (zc->length + zc->blocksize - 1) / zc->blocksize;
+   zc->sums = (const unsigned char *)p;
+   return (size_t)(end - p) >= zc->blocks * (zc->rsum_bytes + zc->checksum_bytes);
+}
+
+static inline unsigned seed_byte(const struct seed *s, size_t x)
+{
+   return x < s->len ? s->data[x] : 0;
+}
+
+/**
+ * Weak checksum of zsync: a is the byte sum, b weights each byte by its
+ * distance from the end of the block. Past the end the seed reads as zeros,
+ * like the padded last block of the target.
+ */
+static struct rsum rsum_block(const struct seed *s, size_t x, size_t blocksize)
+{
+   struct rsum r = { 0, 0 };
+
+   for (size_t i = 0; i < blocksize; i++) {
+      unsigned c = seed_byte(s, x + i);
+
+      r.a += c;
+      r.b += (blocksize - i) * c;
+   }
+   return r;
+}
+
+static inline void rsum_roll(struct rsum *r, unsigned out, unsigned in, size_t blocksize)
+{
+   r->a += in - out;
+   r->b += r->a - out * blocksize;
+}
+
+static void checksum_block(const struct seed *s, size_t x, size_t blocksize, unsigned char *scratch,
+      unsigned char checksum[16])
+{
+   if (x + blocksize <= s->len) {
+      md4(s->data + x, blocksize, checksum);
+      return;
+   }
+
+   for (size_t i = 0; i < blocksize; i++) {
+      scratch[i] = seed_byte(s, x + i);
+   }
+   md4(scratch, blocksize, checksum);
+}
+
+static inline uint32_t make_key(struct rsum r, struct rsum next, const struct zsync_control *zc)
+{
+   uint16_t a_mask = zc->rsum_bytes < 3 ? 0 : zc->rsum_bytes == 3 ? 0xff : 0xffff;
+   uint16_t b_mask = zc->rsum_bytes < 2 ? 0xff : 0xffff;
+
+   // With seq_matches 2 a block is only looked up together with the one after it.
+   if (zc->seq_matches > 1) {
+      return (r.b & b_mask) | ((uint32_t)(next.b & b_mask) << 16);
+   }
+   return (r.b & b_mask) | ((uint32_t)(r.a & a_mask) << 16);
+}
+
+static inline uint32_t hash_key(uint32_t key, int bits)
+{
+   return (key * 2654435761u) >> (32 - bits);
+}
+
+static struct rsum stored_rsum(const struct zsync_control *zc, size_t block)
+{
+   unsigned char buf[4] = {0};
+   struct rsum r;
+
+   if (block >= zc->blocks) {
+      r.a = r.b = 0;
+      return r;
+   }
+
+   // Only the last rsum_bytes of a(16) b(16), big endian, are stored.
+   memcpy(buf + 4 - zc->rsum_bytes, zc->sums + block * (zc->rsum_bytes + zc->checksum_bytes), zc->rsum_bytes);
+   r.a = (buf[0] << 8) | buf[1];
+   r.b = (buf[2] << 8) | buf[3];
+   return r;
+}
+
+static bool write_block(int fd, const struct seed *s, size_t x, const struct zsync_control *zc, size_t block,
+      unsigned char *scratch)
+{
+   off_t offset = (off_t)block * zc->blocksize;
+   size_t len = zc->length - offset < (long long)zc->blocksize ? zc->length - offset : zc->blocksize;
+   const unsigned char *src = s->data + x;
+
+   if (x + len > s->len) {
+      for (size_t i = 0; i < len; i++) {
+         scratch[i] = seed_byte(s, x + i);
+      }
+      src = scratch;
+   }
+   return pwrite(fd, src, len, offset) == (ssize_t)len;
+}
+
+/**
+ * Slide over the seed with the rolling checksums and copy every target
+ * block found in it. have[] marks the blocks that are in place.
+ */
+static size_t match_seed(const struct zsync_control *zc, const struct seed *s, int fd, bool *have)
+{
+   size_t bs = zc->blocksize, found = 0, table_size;
+   unsigned char *scratch = malloc(bs), window[16], following[16];
+   struct target *targets = calloc(zc->blocks + 1, sizeof(*targets));
+   uint32_t *table;
+   int bits = 4;
+
+   while (((size_t)1 << bits) < zc->blocks * 2) {
+      bits++;
+   }
+   table_size = (size_t)1 << bits;
+   table = calloc(table_size, sizeof(*table));
+
+   if (!scratch || !targets || !table) {
+      free(scratch);
+      free(targets);
+      free(table);
+      return 0;
+   }
+
+   // Entries are numbered from 1 so 0 can end the chains.
+   for (size_t j = 0; j < zc->blocks; j++) {
+      struct target *t = &targets[j + 1];
+      uint32_t h;
+
+      t->key = make_key(stored_rsum(zc, j), stored_rsum(zc, j + 1), zc);
+      memcpy(t->checksum, zc->sums + j * (zc->rsum_bytes + zc->checksum_bytes) + zc->rsum_bytes, zc->checksum_bytes);
+      h = hash_key(t->key, bits);
+      t->next = table[h];
+      table[h] = j + 1;
+   }
+
+   for (size_t x = 0; x < s->len; ) {
+      struct rsum r0 = rsum_block(s, x, bs), r1 = rsum_block(s, x + bs, bs);
+      bool matched = false;
+
+      for (; x < s->len; x++) {
+         uint32_t key = make_key(r0, r1, zc);
+         bool hashed = false, next_hashed = false;
+
+         for (uint32_t e = table[hash_key(key, bits)]; e != 0; e = targets[e].next) {
+            size_t j = e - 1;
+
+            if (have[j] || targets[e].key != key) {
+               continue;
+            }
+
+            if (!hashed) {
+               checksum_block(s, x, bs, scratch, window);
+               hashed = true;
+            }
+            if (memcmp(window, targets[e].checksum, zc->checksum_bytes) != 0) {
+               continue;
+            }
+
+            // The block after it has to match as well.
+            if (zc->seq_matches > 1 && j + 1 < zc->blocks) {
+               if (!next_hashed) {
+                  checksum_block(s, x + bs, bs, scratch, following);
+                  next_hashed = true;
+               }
+               if (memcmp(following, targets[e + 1].checksum, zc->checksum_bytes) != 0) {
+                  continue;
+               }
+            }
+
+            if (write_block(fd, s, x, zc, j, scratch)) {
+               have[j] = true;
+               found++;
+               matched = true;
+            }
+         }
+
+         if (matched) {
+            break;
+         }
+
+         rsum_roll(&r0, seed_byte(s, x), seed_byte(s, x + bs), bs);
+         rsum_roll(&r1, seed_byte(s, x + bs), seed_byte(s, x + 2 * bs), bs);
+      }
+
+      // Continue right after a matched block.
+      if (matched) {
+         x += bs;
+      }
+   }
+
+   free(scratch);
+   free(targets);
+   free(table);
+   return found;
+}
+
+/**
+ * Turn the runs of missing blocks into [from, to) byte ranges. Small gaps
+ * between runs are fetched as well, to save requests.
+ */
+static size_t missing_ranges(const struct zsync_control *zc, const bool *have, long long *ranges, long long *missing)
+{
+   size_t count = 0;
+
+   *missing = 0;
+
+   for (size_t j = 0; j < zc->blocks; j++) {
+      long long from = (long long)j * zc->blocksize, to;
+
+      if (have[j]) {
+         continue;
+      }
+
+      while (j + 1 < zc->blocks && !have[j + 1]) {
+         j++;
+      }
+      to = (long long)(j + 1) * zc->blocksize < zc->length ? (long long)(j + 1) * zc->blocksize : zc->length;
+
+      if (count > 0 && from - ranges[count * 2 - 1] <= MAX_GAP) {
+         *missing += to - ranges[count * 2 - 1];
+         ranges[count * 2 - 1] = to;
+      } else {
+         *missing += to - from;
+         ranges[count * 2] = from;
+         ranges[count * 2 + 1] = to;
+         count++;
+      }
+   }
+   return count;
+}
+
+/**
+ * Write the blocks found in seed to path and download the rest.
+ */
+static bool apply_delta(const struct zsync_control *zc, const struct seed *seed, const char *url, const char *path)
+{
+   bool *have = calloc(zc->blocks, sizeof(*have)), ok = false;
+   long long *ranges = malloc(zc->blocks * 2 * sizeof(*ranges)), missing = 0;
+   int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   size_t count = 0;
+
+   if (fd >= 0 && have && ranges && ftruncate(fd, zc->length) == 0) {
+      if (match_seed(zc, seed, fd, have) == 0) {
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Installed version shares no blocks with the update.\n");
+      } else {
+         count = missing_ranges(zc, have, ranges, &missing);
+         launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Delta update: %.1f MB reused from the installed version, "
+               "%.1f MB to download in %zu ranges\n", (zc->length - missing) / 1048576.0, missing / 1048576.0, count);
+         ok = true;
+      }
+   }
+
+   if (fd >= 0 && close(fd) != 0) {
+      ok = false;
+   }
+
+   ok = ok && http_fetch_ranges(url, path, ranges, count);
+
+   free(have);
+   free(ranges);
+   return ok;
+}
+
+bool zsync_download(const char *zsync_url, const char *url, const char *seed_path, const char *path)
+{
+   struct timespec start, end;
+   struct http_response resp;
+   struct zsync_control zc;
+   struct seed seed = { NULL, 0 };
+   struct stat st;
+   char sha1[41];
+   bool ok;
+   int fd;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   if (!http_get(zsync_url, NULL, &resp) || resp.status != 200 || !parse_control(resp.body, resp.body_len, &zc)) {
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: No usable zsync file at %s\n", zsync_url);
+      http_response_free(&resp);
+      return false;
+   }
+
+   if ((fd = open(seed_path, O_RDONLY | O_CLOEXEC)) < 0) {
+      http_response_free(&resp);
+      return false;
+   }
+
+   if (fstat(fd, &st) != 0 || st.st_size == 0
+         || (seed.data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+      close(fd);
+      http_response_free(&resp);
+      return false;
+   }
+
+   seed.len = st.st_size;
+   madvise((void *)seed.data, seed.len, MADV_SEQUENTIAL);
+
+   ok = apply_delta(&zc, &seed, url, path);
+
+   munmap((void *)seed.data, seed.len);
+   close(fd);
+
+   if (ok && zc.sha1[0] != '\0' && (!sha1_file(path, sha1) || strcasecmp(sha1, zc.sha1) != 0)) {
+      launcher_log(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Delta update produced a corrupt file.\n");
+      ok = false;
+   }
+
+   http_response_free(&resp);
+
+   if (ok) {
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      launcher_log(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Delta update finished in %.1fs\n",
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+   }
+   return ok;
+}
@@ -0,0 +1,14 @@
+#ifndef LAUNCHER_ZSYNC_H
+#define LAUNCHER_ZSYNC_H
+
+#include <stdbool.h>
+
+/**
+ * Delta download of url to path with the zsync control file at zsync_url.
+ * Blocks already present in seed, the installed release, are copied from
+ * it and only the missing ranges of url are downloaded. Returns false if
+ * the delta can't be used, the caller then downloads the whole file.
+ */
+bool zsync_download(const char *zsync_url, const char *url, const char *seed, const char *path);
+
+#endif
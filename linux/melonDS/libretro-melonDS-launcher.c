@@ -4,6 +4,20 @@
 #include <stdarg.h>
 #include <string.h>
 #include "libretro.h"
+#include "log.h"
+#include "http.h"
+#include "options.h"
+#include "mirror.h"
+#include "release.h"
+#include "update.h"
+#include "install.h"
+#include "cpu.h"
+#include "cgroup.h"
+#include "launch.h"
+#include "prefetch.h"
+#include "session.h"
+#include "state.h"
+#include "trace.h"
 #include <glob.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -11,6 +25,13 @@
 #include <fcntl.h>
 
 #define ELF_MAGIC "\x7F""ELF"
+#define CORE_NAME "melonDS"
+#define RELEASE_ASSET 1
+#define RELEASE_FORMAT ARCHIVE_ZIP
+#define RELEASE_STRIP 0
+
+// Releases are archives, extracted to versions/<id>.
+static const struct install_layout layout = { NULL, RELEASE_FORMAT, RELEASE_STRIP };
 
 static uint32_t *frame_buf;
 static struct retro_log_callback logging;
@@ -28,12 +49,18 @@ static void fallback_log(enum retro_log_level level, const char *fmt, ...)
 void retro_init(void)
 {
    frame_buf = calloc(320 * 240, sizeof(uint32_t));
+   http_init();
 }
 
 void retro_deinit(void)
 {
    free(frame_buf);
    frame_buf = NULL;
+   // Ends the trace of a launch that failed.
+   trace_finish();
+   update_stop();
+   prefetch_stop();
+   http_deinit();
 }
 
 unsigned retro_api_version(void)
@@ -79,6 +106,11 @@ void retro_get_system_av_info(struct retro_system_av_info *info)
       .max_height   = 240,
       .aspect_ratio = aspect,
    };
+
+   // Nothing is shown while the emulator runs, the frontend only has to wake up now and then.
+   if (session_idle()) {
+      session_idle_av_info(info);
+   }
 }
 
 void retro_set_environment(retro_environment_t cb)
@@ -92,6 +124,9 @@ void retro_set_environment(retro_environment_t cb)
       log_cb = logging.log;
    else
       log_cb = fallback_log;
+
+   launcher_log = log_cb;
+   options_init(cb, CORE_NAME);
 }
 
 void retro_set_audio_sample(retro_audio_sample_t cb)
@@ -131,9 +166,31 @@ void retro_reset(void)
  */
 void retro_run(void)
 {
-   // Clear the display.
-   unsigned stride = 320;
-   video_cb(frame_buf, 320, 240, stride << 2);
+   int status;
+
+   // Clear the display, or let the frontend repeat its last frame while idle.
+   if (session_idle()) {
+      video_cb(NULL, 64, 48, 0);
+   } else {
+      unsigned stride = 320;
+      video_cb(frame_buf, 320, 240, stride << 2);
+   }
+
+   // The frontend keeps running along with a supervised emulator, until it exits.
+   if (session_active()) {
+      if (!session_exited(&status)) {
+         return;
+      }
+
+      if (status == 0) {
+         log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Finished running melonDS.\n");
+      } else {
+         log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed running melonDS.\n");
+      }
+   }
+
+   // Blocking and supervised sessions are over by now, which ends the emulator phase.
+   trace_finish();
 
    // Shutdown the environment
    environ_cb(RETRO_ENVIRONMENT_SHUTDOWN, NULL);
@@ -195,146 +252,47 @@ static char *setup(char **Paths, size_t numPaths, char *executable)
 
 static bool downloader(char **Paths, char **downloaderDirs, char **githubUrls, char *executable, size_t numPaths)
 {
-   char url[260] = {0}, currentVersion[32] = {0}, newVersion[32] = {0};
-   char bashCommand[1024] = {0}, downloadCmd[1024] = {0}; 
-
-   if (strlen(executable) == 0) {
-
-      char bashCommand[1024] = {0};
-
-      snprintf(bashCommand, sizeof(bashCommand),
-         "bash -c 'json_data=$(curl -s -H \"Accept: application/json\" \"%s\"); "
-         "tag=$(echo \"$json_data\" | jq -r \".tag_name\"); "
-         "name=$(echo \"$json_data\" | jq -r \".assets[1].name\"); "
-         "id=$(echo \"$json_data\" | jq -r \".assets[1].id\"); "
-         "if [ -z \"$tag\" ] || [ -z \"$name\" ] || [ \"$tag\" = \"null\" ] || [ \"$id\" = \"null\" ]  || [ \"$name\" = \"null\" ]; then exit 1; fi; "
-         "url=\"%s$tag/$name\"; "
-         "echo \"$url\" > \"%s\";"
-         "echo \"$id\"  > \"%s\"'",
-         githubUrls[0], githubUrls[1], downloaderDirs[0], downloaderDirs[1]);
-
-      if (system(bashCommand) != 0) {
-            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to fetch download URL, aborting.\n");
-            return false;
-         } else { // If it's first download, extract only URL for download. Current version is already saved by bash.
-            FILE *urlFile = fopen(downloaderDirs[0], "r");
-            
-            if (!urlFile) {
-               log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to read version file, aborting.\n");
-               return false;
-            } else {
-               fgets(url, sizeof(url), urlFile);
-               fclose(urlFile);
-               url[strcspn(url, "\n")] = 0;
-            }
-         }
+   struct cache_entry entry;
 
-      snprintf(downloadCmd, sizeof(downloadCmd), "wget -O %s/melonDS.zip %s", Paths[0], url);
-      
-      if (system(downloadCmd) != 0) {
-            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to download emulator, aborting.\n");
-            return false;
-         } else {
-            log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Extracting archive.\n");
-            return true;
-         }
-   } else { // If it's not the first download, fetch newVersion ID.
-         snprintf(bashCommand, sizeof(bashCommand),
-       "bash -c 'json_data=$(curl -s -H \"Accept: application/json\" \"%s\"); "
-               "tag=$(echo \"$json_data\" | jq -r \".tag_name\"); "
-               "name=$(echo \"$json_data\" | jq -r \".assets[1].name\"); "
-               "id=$(echo \"$json_data\" | jq -r \".assets[1].id\"); "
-               "if [ -z \"$tag\" ] || [ -z \"$name\" ] || [ \"$tag\" = \"null\" ] || [ \"$id\" = \"null\" ]  || [ \"$name\" = \"null\" ]; then exit 1; fi; "
-               "url=\"%s$tag/$name\"; "
-               "echo \"$url\" > \"%s\";"
-               "echo \"$id\"  > \"%s\"'",
-               githubUrls[0], githubUrls[1], downloaderDirs[0], downloaderDirs[2]);
-         
-         if (system(bashCommand) != 0) {
-            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to fetch update, aborting.\n");
-            return false;
-         } else { // Extract URL, currentID and newID for comparison
-            FILE *urlFile = fopen(downloaderDirs[0], "r");
-            FILE *currentVersionFile = fopen(downloaderDirs[1], "r");
-            FILE *newVersionFile = fopen(downloaderDirs[2], "r");
-            
-            if (!urlFile && !currentVersionFile && ! newVersionFile) {
-               log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Metadata files not found. Aborting.\n");
-               return false;
-            } else {
-               fgets(url, sizeof(url), urlFile);
-               fgets(currentVersion, sizeof(currentVersion), currentVersionFile);
-               fgets(newVersion, sizeof(newVersion), newVersionFile);
-               fclose(urlFile);
-               fclose(currentVersionFile);
-               fclose(newVersionFile);
-               
-               url[strcspn(url, "\n")] = 0;
-
-               if (strcmp(currentVersion, newVersion) != 0) {
-                  log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Update found. Downloading Update\n");
-                  snprintf(downloadCmd, sizeof(downloadCmd), "wget -O %s/melonDS.zip %s", Paths[0], url);
-                  
-                  if (system(downloadCmd) != 0) {
-                     log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to download update, aborting.\n");
-                     return false;
-                  } else {
-                     // Overwrite Current version.txt file with new ID if download was successfull.
-                     snprintf(bashCommand, sizeof(bashCommand),
-                   "bash -c 'json_data=$(curl -s -H \"Accept: application/json\" \"%s\"); "
-                           "id=$(echo \"$json_data\" | jq -r \".assets[1].id\"); "
-                           "if [ \"$id\" = \"null\" ]; then exit 1; fi; "
-                           "url=\"%s$tag/$name\"; "
-                           "echo \"$id\"  > \"%s\"'",
-                           githubUrls[0], githubUrls[1], downloaderDirs[1]);
-                  
-                     if (system(bashCommand) != 0) {
-                        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to update current version file. Aborting.\n");
-                        return false;
-                     } else {
-                        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Success. Extracting archive.\n");
-                        return true;
-                     }
-                  }
-               } else {
-                  log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: No update found.\n");
-               }
-            }
-         }
+   // Tag, asset name, id and URL are resolved in-process, at most once per update check interval.
+   if (!release_check(downloaderDirs[0], CORE_NAME, githubUrls, RELEASE_ASSET, strlen(executable) > 0,
+         options_get_seconds("cache_ttl"), &entry)) {
+      if (strlen(executable) == 0) {
+         log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to fetch download URL, aborting.\n");
+      } else {
+         log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to fetch update, aborting.\n");
+      }
+      return false;
    }
-   return false;
-}
 
-/**
- * Extract emulator archive. If content is in a subfolder
- * move it to the main folder, and delete the tmp folder.
- * Apply execution permission afterwards.
- */
-static bool extractor(char **Paths)
-{
-   char extractCmd[1204] = {0};
-   snprintf(extractCmd, sizeof(extractCmd), 
-    "mkdir %s/tmp_dir && "
-           "unzip %s/melonDS.zip -d %s/tmp_dir && " 
-           "mv %s/tmp_dir/* %s && " \
-           "rm -rf %s/tmp_dir && "
-           "rm %s/melonDS.zip && "
-           "chmod +x %s", 
-           Paths[0], Paths[0], Paths[0], Paths[0], Paths[0], Paths[0], Paths[0], Paths[6]);
-   
-   if (system(extractCmd) != 0) {
-      log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to extract emulator, aborting.\n");
+   // If it's not the first download, compare current and new version ID.
+   if (strlen(executable) > 0) {
+      if (!release_update_available(&entry)) {
+         log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: No update found.\n");
+         return false;
+      }
+      log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Update found. Downloading Update\n");
+   }
+
+   // The archive is extracted to its own version folder while it downloads, it is never written to disk.
+   if (!install_download(&entry, Paths[0], &layout) || !install_activate(Paths[0], entry.latest)
+         || chmod(Paths[6], 0755) != 0) {
+      log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to download emulator, aborting.\n");
       return false;
-   } else {
-      log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Success.\n");
+   }
 
+   // Record the installed ID from the same metadata used for the download.
+   if (!release_installed(downloaderDirs[0], CORE_NAME, entry.latest)) {
+      log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR]: Failed to update release metadata cache.\n");
    }
+
+   log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Success.\n");
    return true;
 }
 
 /**
  * libretro callback; Called when a game is to be loaded.
-*  - attach ROM absolute path from info->path in double quotes for system() function, avoids truncation.
+*  - pass ROM absolute path from info->path as its own argument of the emulator, no quoting or truncation.
 *  - if info->path has no ROM, fallback to bios file placed by the user.
    NOTE: info structure must be checked when is not null
  */
@@ -349,14 +307,13 @@ bool retro_load_game(const struct retro_game_info *info)
          "/.config/retroarch/thumbnails/Nintendo - Nintendo DS/Named_Boxarts",
          "/.config/retroarch/thumbnails/Nintendo - Nintendo DS/Named_Snaps",
          "/.config/retroarch/thumbnails/Nintendo - Nintendo DS/Named_Titles",
-         "/.config/retroarch/system/melonDS/melonDS-x86_64.AppImage" // search Path for glob.
+         "/.config/retroarch/system/melonDS/current/melonDS-x86_64.AppImage" // search Path for glob.
       };
 
-   // Emulator build versions and URL to download. Content is generated from powershell cmds
+   // Release metadata cache shared by all launchers, and the release mirror of the local network, if any.
    char *downloaderDirs[] = {
-      "/.config/retroarch/system/melonDS/0.Url.txt",
-      "/.config/retroarch/system/melonDS/1.CurrentVersion.txt",
-      "/.config/retroarch/system/melonDS/2.NewVersion.txt",
+      "/.config/retroarch/system/launcher.cache",
+      "/.config/retroarch/system/launcher.mirror",
    };
 
    char *githubUrls[] = {
@@ -381,22 +338,106 @@ bool retro_load_game(const struct retro_game_info *info)
       asprintf(&downloaderDirs[i], "%s%s", home, tmp );
    }
 
-   setup(dirs, numPaths, executable);
-   
-   // If an archive was downloaded extract it.
-   if (downloader(dirs, downloaderDirs, githubUrls, executable, numPaths)) {
-      extractor(dirs);
+   // Each phase of the launch is timed, the summary is logged once it ended.
+   trace_start(environ_cb);
+   trace_phase("options");
+
+   if (strcmp(options_get("launch_trace"), "enabled") == 0) {
+      trace_set_file(dirs[0]);
+   }
+
+   mirror_load(downloaderDirs[1]);
+
+   // Large releases are fetched as parallel range requests.
+   http_set_connections(options_get_number("download_connections"),
+         options_get_number("download_segment_size") * 1048576LL);
+
+   // Previous versions are kept for rollback, within the disk budget.
+   install_set_limits(options_get_number("keep_versions"), options_get_number("disk_budget") * 1073741824LL);
+
+   // The emulator runs on the cores that suit it best, the frontend keeps the rest.
+   bool smt = strcmp(options_get("cpu_smt"), "all") == 0;
+   long priority = options_get_number("emulator_priority");
+   cpu_set_placement(options_get("cpu_placement"), smt, priority);
+
+   // In a delegated cgroup the emulator outweighs the frontend and its downloads.
+   cgroup_set_enabled(strcmp(options_get("resource_groups"), "enabled") == 0);
+
+   trace_phase("validation");
+
+   // A launch within the update check interval of the last full one only stats the executable.
+   bool warm = state_fast_path(dirs[0], options_get_seconds("cache_ttl"), executable, sizeof(executable));
+
+   if (!warm) {
+      // Lets the batch updater (linux/tools/update-all) update this core too.
+      update_register(downloaderDirs[0], CORE_NAME, githubUrls, RELEASE_ASSET, dirs[0], &layout);
+
+      // Swap in a release staged by a background update during the last session.
+      update_promote(downloaderDirs[0], CORE_NAME, dirs[0], &layout);
+
+      setup(dirs, numPaths, executable);
+
+      // Before the update check, an update staged by it removes the record again.
+      if (strlen(executable) > 0) {
+         state_record(dirs[0], executable);
+      }
+   }
+
+   // Warm the page cache with the emulator and the start of the ROM while the update check runs.
+   if (strlen(executable) > 0) {
+      prefetch_start(executable, info != NULL ? info->path : NULL,
+            options_get_number("content_prefetch") * 1048576LL);
    }
 
+   trace_phase("update check");
+
+   // With background updates the installed version is launched right away.
+   if (warm) {
+      log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Checked for updates recently, skipping the update check.\n");
+   } else if (strlen(executable) > 0 && strcmp(options_get("update_mode"), "background") == 0) {
+      update_start(downloaderDirs[0], CORE_NAME, githubUrls, RELEASE_ASSET,
+            options_get_seconds("cache_ttl"), dirs[0], &layout);
+   } else {
+      downloader(dirs, downloaderDirs, githubUrls, executable, numPaths);
+   }
+
+   trace_phase("launch");
+
    // if executable exists, only then try to launch it.
    if (strlen(executable) > 0) {
+      // Started without a shell, the ROM path is passed as is.
+      char *argv[5] = { executable };
+      char apprun[1200];
+      int argc = 1;
+
       if (info != NULL && info->path != NULL) {
-         char args[512] = {0};
-         snprintf(args, sizeof(args), " -f \"%s\"", info->path);
-         strncat(executable, args, sizeof(executable)-1);
+         argv[argc++] = "-f";
+         argv[argc++] = (char *)info->path;
+      }
+
+      // Unpacked once per version, the AppImage then starts without its FUSE mount.
+      if (install_appdir(executable, strcmp(options_get("appimage_mode"), "extracted") == 0, apprun, sizeof(apprun))) {
+         argv[0] = apprun;
+      }
+
+      trace_phase("emulator");
+
+      // The frontend quits to make room for the emulator and is started again after it.
+      if (strcmp(options_get("session_mode"), "handoff") == 0) {
+         return session_handoff(argv);
+      }
+
+      // Started in the background and watched by retro_run(), the frontend stays responsive.
+      if (strcmp(options_get("session_mode"), "supervised") == 0) {
+         bool dupe = false;
+
+         // The frontend idles during the session, if it can repeat frames.
+         environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &dupe);
+         session_set_idle(dupe && strcmp(options_get("idle_frontend"), "enabled") == 0);
+         return session_start(argv);
       }
 
-      if (system(executable) == 0) {
+      if (launch_run(argv) == 0) {
          log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Finished running melonDS.\n");
          return true;
       } else {
@@ -408,7 +449,9 @@ bool retro_load_game(const struct retro_game_info *info)
 
 void retro_unload_game(void)
 {
-   // Nothing needs to happen when the game unloads.
+   // Quit a supervised emulator that is still running.
+   session_stop();
+   cpu_restore();
 }
 
 unsigned retro_get_region(void)
@@ -0,0 +1,152 @@
+/**
+ * archive-bench: time the in-process extraction engine of the launchers
+ * against the shell pipeline they used before (mkdir, unzip/tar, mv, rm),
+ * on the same archive and the same disk.
+ *
+ * Every run extracts into a fresh directory next to the archive, which is
+ * removed outside the timed part. The page cache is left warm, so the
+ * numbers compare the extraction work rather than reading the archive.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ftw.h>
+#include <unistd.h>
+#include "archive.h"
+#include "log.h"
+
+#define MAX_RUNS 64
+
+static void usage(const char *name)
+{
+   fprintf(stderr,
+         "Usage: %s [-n runs] [-s strip] archive.{zip,tar.gz,tar.xz}\n"
+         "  -n  runs of each method (default 5)\n"
+         "  -s  leading path components to strip, like the launchers (default 1)\n", name);
+}
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+   return remove(path);
+}
+
+static void remove_tree(const char *path)
+{
+   nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/**
+ * The extractor() command of the launchers, minus deleting the archive.
+ */
+static bool shell_extract(const char *archive, enum archive_format format, const char *dest, int strip)
+{
+   static const char *tools[] = { "unzip -q", "tar -xzf", "tar -xJf" };
+   char cmd[4096];
+
+   snprintf(cmd, sizeof(cmd), "mkdir %s/tmp_dir && %s %s %s %s/tmp_dir && mv %s/tmp_dir/%s %s && rm -rf %s/tmp_dir",
+         dest, tools[format], archive, format == ARCHIVE_ZIP ? "-d" : "-C", dest,
+         dest, strip > 0 ? "*/*" : "*", dest, dest);
+   return system(cmd) == 0;
+}
+
+static bool engine_extract(const char *archive, enum archive_format format, const char *dest, int strip)
+{
+   return archive_extract(archive, format, dest, strip);
+}
+
+static int compare(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+
+   return (x > y) - (x < y);
+}
+
+/**
+ * Run one method runs times and return its median time, or a negative value on failure.
+ */
+static double bench(const char *label, bool (*extract)(const char *, enum archive_format, const char *, int),
+      const char *archive, enum archive_format format, int strip, int runs, double size)
+{
+   double times[MAX_RUNS], median;
+
+   for (int i = 0; i < runs; i++) {
+      char dest[1100];
+      double start;
+
+      snprintf(dest, sizeof(dest), "%s.bench.XXXXXX", archive);
+
+      if (!mkdtemp(dest)) {
+         perror("mkdtemp");
+         return -1;
+      }
+
+      start = now();
+      if (!extract(archive, format, dest, strip)) {
+         fprintf(stderr, "%s: extraction failed\n", label);
+         remove_tree(dest);
+         return -1;
+      }
+      times[i] = now() - start;
+      remove_tree(dest);
+   }
+
+   qsort(times, runs, sizeof(times[0]), compare);
+   median = times[runs / 2];
+   printf("%-8s best %.3fs  median %.3fs  %.1f MB/s of archive\n", label, times[0], median, size / median);
+   return median;
+}
+
+int main(int argc, char **argv)
+{
+   enum archive_format format;
+   int runs = 5, strip = 1, opt;
+   double engine, shell, size;
+   struct stat st;
+
+   while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+      switch (opt) {
+      case 'n':
+         runs = atoi(optarg);
+         break;
+      case 's':
+         strip = atoi(optarg);
+         break;
+      default:
+         usage(argv[0]);
+         return opt == 'h' ? 0 : 2;
+      }
+   }
+
+   if (optind != argc - 1 || !archive_format_from_name(argv[optind], &format)) {
+      usage(argv[0]);
+      return 2;
+   }
+
+   if (stat(argv[optind], &st) != 0) {
+      perror(argv[optind]);
+      return 1;
+   }
+
+   runs = runs < 1 ? 1 : runs > MAX_RUNS ? MAX_RUNS : runs;
+   size = st.st_size / 1048576.0;
+
+   engine = bench("engine", engine_extract, argv[optind], format, strip, runs, size);
+   shell = bench("shell", shell_extract, argv[optind], format, strip, runs, size);
+
+   if (engine <= 0 || shell <= 0) {
+      return 1;
+   }
+
+   printf("engine is %.2fx the speed of the shell pipeline\n", shell / engine);
+   return 0;
+}
@@ -0,0 +1,961 @@
+/**
+ * launch-bench: time retro_load_game() of a launcher core outside of
+ * RetroArch.
+ *
+ * The core is loaded with dlopen() and driven through the libretro API
+ * with stub callbacks. Its HOME is a scratch directory, and
+ * LAUNCHER_GITHUB_URL points its release checks at an HTTP server in this
+ * process that answers like the GitHub releases API and asset downloads,
+ * with optional latency, bandwidth limit and failed requests. The release
+ * it serves holds a stand-in emulator that exits right away, packed like
+ * the real asset of the core.
+ *
+ * Each scenario launches the core n times and prints latency percentiles:
+ *   cold install  nothing installed, the release is downloaded and installed
+ *   no update     installed, the release check finds nothing new
+ *   warm          checked within the update check interval, no request
+ *   update        a new release is published before every launch
+ *   offline       the server is unreachable, the installed version runs
+ * Failed launches make the exit status 1, unless failures were injected.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <ftw.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "libretro.h"
+#include "sha256.h"
+
+#define MAX_RUNS 1000
+#define ASSETS 10 // the highest asset index of the launchers is 9
+#define CHUNK 16384
+
+enum payload_format {
+   PAYLOAD_FILE,
+   PAYLOAD_ZIP,
+   PAYLOAD_TAR_GZ
+};
+
+/**
+ * What each launcher downloads, kept in line with their RELEASE_* defines
+ * and the path their setup() looks for.
+ */
+struct core_release {
+   const char *core;
+   int asset;
+   const char *name;
+   enum payload_format format;
+   const char *member; // path of the emulator in the archive
+};
+
+static const struct core_release releases[] = {
+   { "duckstation", 9, "duckstation.AppImage", PAYLOAD_FILE, NULL },
+   { "lime3ds", 2, "lime3ds.tar.gz", PAYLOAD_TAR_GZ, "lime3ds/lime3ds.AppImage" },
+   { "mGBA", 2, "mGBA.AppImage", PAYLOAD_FILE, NULL },
+   { "melonDS", 1, "melonDS.zip", PAYLOAD_ZIP, "melonDS-x86_64.AppImage" },
+   { "pcsx2", 0, "pcsx2.AppImage", PAYLOAD_FILE, NULL },
+   { "rpcs3", 0, "rpcs3.AppImage", PAYLOAD_FILE, NULL },
+   { "ryujinx", 6, "ryujinx.AppImage", PAYLOAD_FILE, NULL },
+   { "xemu", 6, "xemu.AppImage", PAYLOAD_FILE, NULL },
+   { "xenia_canary", 1, "xenia_canary.zip", PAYLOAD_ZIP, "xenia_canary.exe" },
+};
+
+struct core_api {
+   void (*set_environment)(retro_environment_t);
+   void (*set_video_refresh)(retro_video_refresh_t);
+   void (*set_audio_sample)(retro_audio_sample_t);
+   void (*set_audio_sample_batch)(retro_audio_sample_batch_t);
+   void (*set_input_poll)(retro_input_poll_t);
+   void (*set_input_state)(retro_input_state_t);
+   void (*init)(void);
+   void (*deinit)(void);
+   void (*run)(void);
+   bool (*load_game)(const struct retro_game_info *);
+   void (*unload_game)(void);
+};
+
+struct scenario {
+   const char *name;
+   const char *cache_ttl;
+   bool fresh_home;
+   bool new_release;
+   bool offline;
+};
+
+static const struct scenario scenarios[] = {
+   { "cold install", "every launch", true, false, false },
+   { "no update", "every launch", false, false, false },
+   { "warm", "1 hour", false, false, false },
+   { "update", "every launch", false, true, false },
+   { "offline", "every launch", false, false, true },
+};
+
+// Server settings, set before it starts.
+static int latency_ms;
+static double bandwidth; // bytes per second, 0 for unlimited
+static int failure_rate; // percent of requests
+
+static pthread_mutex_t server_lock = PTHREAD_MUTEX_INITIALIZER;
+static const struct core_release *release;
+static unsigned char *asset;
+static size_t asset_size;
+static char digest[65];
+static int generation = 1;
+static bool inject = true;
+static unsigned seed = 1;
+static double link_free;
+static long requests;
+static long long served;
+
+static bool verbose;
+static const char *cache_ttl;
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_for(double seconds)
+{
+   struct timespec ts = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+
+   nanosleep(&ts, NULL);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+   return remove(path);
+}
+
+static void remove_tree(const char *path)
+{
+   nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static void write_file(const char *path, const char *text, mode_t mode)
+{
+   FILE *file = fopen(path, "w");
+
+   if (file) {
+      fputs(text, file);
+      fclose(file);
+      chmod(path, mode);
+   }
+}
+
+static void put16(unsigned char *p, unsigned v)
+{
+   p[0] = v & 0xff;
+   p[1] = (v >> 8) & 0xff;
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+   put16(p, v & 0xffff);
+   put16(p + 2, (v >> 16) & 0xffff);
+}
+
+/**
+ * The stand-in emulator: true(1), since the launchers only take an ELF
+ * executable, padded with incompressible bytes to the size of a release,
+ * like the squashfs image appended to an AppImage.
+ */
+static unsigned char *make_emulator(size_t *size)
+{
+   unsigned char *data;
+   uint32_t x = 2463534242u;
+   size_t len;
+   FILE *file = fopen("/bin/true", "rb");
+
+   if (!file) {
+      file = fopen("/usr/bin/true", "rb");
+   }
+
+   if (!file) {
+      perror("true");
+      return NULL;
+   }
+
+   fseek(file, 0, SEEK_END);
+   len = ftell(file);
+   rewind(file);
+   *size = *size > len ? *size : len;
+
+   if (!(data = malloc(*size)) || fread(data, 1, len, file) != len) {
+      fclose(file);
+      free(data);
+      return NULL;
+   }
+
+   fclose(file);
+
+   for (size_t i = len; i < *size; i++) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      data[i] = x & 0xff;
+   }
+   return data;
+}
+
+/**
+ * A zip with the emulator stored, executable like the real ones.
+ */
+static unsigned char *make_zip(const unsigned char *data, size_t size, const char *name, size_t *out_size)
+{
+   size_t name_len = strlen(name), local = 30 + name_len, central = 46 + name_len;
+   unsigned long crc = crc32(0L, data, size);
+   unsigned char *zip = calloc(1, local + size + central + 22), *p;
+
+   if (!zip) {
+      return NULL;
+   }
+
+   put32(zip, 0x04034b50);
+   put16(zip + 4, 10);
+   put32(zip + 14, crc);
+   put32(zip + 18, size);
+   put32(zip + 22, size);
+   put16(zip + 26, name_len);
+   memcpy(zip + 30, name, name_len);
+   memcpy(zip + local, data, size);
+
+   p = zip + local + size;
+   put32(p, 0x02014b50);
+   put16(p + 4, 0x031e); // made by Unix, so the mode in the external attributes counts
+   put16(p + 6, 10);
+   put32(p + 16, crc);
+   put32(p + 20, size);
+   put32(p + 24, size);
+   put16(p + 28, name_len);
+   put32(p + 38, 0100755UL << 16);
+   memcpy(p + 46, name, name_len);
+
+   p += central;
+   put32(p, 0x06054b50);
+   put16(p + 8, 1);
+   put16(p + 10, 1);
+   put32(p + 12, central);
+   put32(p + 16, local + size);
+
+   *out_size = local + size + central + 22;
+   return zip;
+}
+
+static void tar_header(unsigned char *h, const char *name, char type, size_t size)
+{
+   unsigned sum = 0;
+
+   memset(h, 0, 512);
+   snprintf((char *)h, 100, "%s", name);
+   snprintf((char *)h + 100, 8, "%07o", 0755);
+   snprintf((char *)h + 108, 8, "%07o", 0);
+   snprintf((char *)h + 116, 8, "%07o", 0);
+   snprintf((char *)h + 124, 12, "%011zo", size);
+   snprintf((char *)h + 136, 12, "%011o", 0);
+   memset(h + 148, ' ', 8);
+   h[156] = type;
+   memcpy(h + 257, "ustar\0" "00", 8);
+
+   for (int i = 0; i < 512; i++) {
+      sum += h[i];
+   }
+
+   snprintf((char *)h + 148, 8, "%06o", sum);
+}
+
+/**
+ * A tar.gz with the emulator below one top-level folder.
+ */
+static unsigned char *make_tar_gz(const unsigned char *data, size_t size, const char *name, size_t *out_size)
+{
+   size_t tar_size = 512 * 2 + (size + 511) / 512 * 512 + 1024;
+   unsigned char *tar = calloc(1, tar_size), *gz = NULL;
+   char dir[256];
+   z_stream z;
+
+   if (!tar) {
+      return NULL;
+   }
+
+   snprintf(dir, sizeof(dir), "%.*s", (int)(strchr(name, '/') - name + 1), name);
+   tar_header(tar, dir, '5', 0);
+   tar_header(tar + 512, name, '0', size);
+   memcpy(tar + 1024, data, size);
+
+   memset(&z, 0, sizeof(z));
+
+   if (deflateInit2(&z, 1, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+      uLong bound = deflateBound(&z, tar_size);
+
+      if ((gz = malloc(bound))) {
+         z.next_in = tar;
+         z.avail_in = tar_size;
+         z.next_out = gz;
+         z.avail_out = bound;
+         deflate(&z, Z_FINISH);
+         *out_size = z.total_out;
+      }
+      deflateEnd(&z);
+   }
+
+   free(tar);
+   return gz;
+}
+
+static bool make_asset(size_t size)
+{
+   unsigned char *emulator = make_emulator(&size), hash[32];
+   struct sha256 ctx;
+
+   if (!emulator) {
+      return false;
+   }
+
+   if (release->format == PAYLOAD_ZIP) {
+      asset = make_zip(emulator, size, release->member, &asset_size);
+      free(emulator);
+   } else if (release->format == PAYLOAD_TAR_GZ) {
+      asset = make_tar_gz(emulator, size, release->member, &asset_size);
+      free(emulator);
+   } else {
+      asset = emulator;
+      asset_size = size;
+   }
+
+   if (!asset) {
+      return false;
+   }
+
+   sha256_init(&ctx);
+   sha256_update(&ctx, asset, asset_size);
+   sha256_final(&ctx, hash);
+
+   for (int i = 0; i < 32; i++) {
+      snprintf(digest + i * 2, 3, "%02x", hash[i]);
+   }
+   return true;
+}
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+   const char *p = data;
+
+   while (len > 0) {
+      ssize_t sent = send(fd, p, len, MSG_NOSIGNAL);
+
+      if (sent <= 0) {
+         return false;
+      }
+
+      p += sent;
+      len -= sent;
+   }
+   return true;
+}
+
+/**
+ * Send a body over the shared, rate limited link.
+ */
+static bool send_body(int fd, const unsigned char *data, size_t len)
+{
+   while (len > 0) {
+      size_t chunk = len < CHUNK ? len : CHUNK;
+
+      if (bandwidth > 0) {
+         double t, wait;
+
+         pthread_mutex_lock(&server_lock);
+         t = now();
+         link_free = (link_free > t ? link_free : t) + chunk / bandwidth;
+         wait = link_free - t;
+         pthread_mutex_unlock(&server_lock);
+         sleep_for(wait);
+      }
+
+      if (!send_all(fd, data, chunk)) {
+         return false;
+      }
+
+      pthread_mutex_lock(&server_lock);
+      served += chunk;
+      pthread_mutex_unlock(&server_lock);
+      data += chunk;
+      len -= chunk;
+   }
+   return true;
+}
+
+static bool respond(int fd, const char *status, const char *headers, const unsigned char *body, size_t len,
+      size_t send_len, bool head)
+{
+   char buf[512];
+
+   snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nContent-Length: %zu\r\n%s\r\n", status, len, headers);
+   return send_all(fd, buf, strlen(buf)) && (head || send_body(fd, body, send_len));
+}
+
+static bool header_value(const char *request, const char *name, char *value, size_t size)
+{
+   const char *p = strcasestr(request, name);
+
+   if (!p) {
+      return false;
+   }
+
+   p += strlen(name);
+   p += strspn(p, " ");
+   snprintf(value, size, "%.*s", (int)strcspn(p, "\r\n"), p);
+   return true;
+}
+
+/**
+ * GET /repos/<owner>/<repo>/releases/latest with every asset pointing at
+ * the stand-in emulator, so the asset index of any launcher finds it.
+ */
+static bool serve_release(int fd, const char *request, int gen, bool fail)
+{
+   char json[4096], etag[64], headers[160], match[128];
+   size_t len;
+
+   if (fail) {
+      return respond(fd, "503 Service Unavailable", "", NULL, 0, 0, false);
+   }
+
+   snprintf(etag, sizeof(etag), "\"bench-%d\"", gen);
+
+   if (header_value(request, "If-None-Match:", match, sizeof(match)) && strcmp(match, etag) == 0) {
+      snprintf(headers, sizeof(headers), "ETag: %s\r\n", etag);
+      return respond(fd, "304 Not Modified", headers, NULL, 0, 0, true);
+   }
+
+   len = snprintf(json, sizeof(json), "{\"tag_name\":\"bench-%d\",\"assets\":[", gen);
+
+   for (int i = 0; i < ASSETS; i++) {
+      len += snprintf(json + len, sizeof(json) - len,
+            "%s{\"name\":\"%s\",\"id\":%d,\"size\":%zu,\"digest\":\"sha256:%s\"}",
+            i ? "," : "", release->name, gen * 100 + i, asset_size, digest);
+   }
+
+   len += snprintf(json + len, sizeof(json) - len, "]}");
+   snprintf(headers, sizeof(headers), "Content-Type: application/json\r\nETag: %s\r\n", etag);
+   return respond(fd, "200 OK", headers, (unsigned char *)json, len, len, false);
+}
+
+/**
+ * GET or HEAD /<owner>/<repo>/releases/download/<tag>/<name>, with ranges.
+ * A failed download is cut off halfway through.
+ */
+static bool serve_asset(int fd, const char *request, bool head, bool fail)
+{
+   char range[64], headers[160];
+   unsigned long long first = 0, last = asset_size - 1;
+   size_t len;
+
+   if (header_value(request, "Range:", range, sizeof(range))
+         && sscanf(range, "bytes=%llu-%llu", &first, &last) >= 1) {
+      if (first >= asset_size) {
+         return respond(fd, "416 Range Not Satisfiable", "", NULL, 0, 0, true);
+      }
+
+      last = last >= asset_size ? asset_size - 1 : last;
+      len = last - first + 1;
+      snprintf(headers, sizeof(headers), "Accept-Ranges: bytes\r\nContent-Range: bytes %llu-%llu/%zu\r\n",
+            first, last, asset_size);
+      return respond(fd, "206 Partial Content", headers, asset + first, len, fail ? len / 2 : len, head) && !fail;
+   }
+
+   return respond(fd, "200 OK", "Accept-Ranges: bytes\r\n", asset, asset_size, fail ? asset_size / 2 : asset_size,
+         head) && !fail;
+}
+
+static void *serve_connection(void *arg)
+{
+   int fd = (int)(intptr_t)arg;
+   char request[8192] = "";
+
+   for (;;) {
+      char method[8], path[1024];
+      size_t len = 0;
+      bool ok, fail;
+      int gen;
+
+      // Requests carry no body, the headers end the request.
+      while (!strstr(request, "\r\n\r\n")) {
+         ssize_t got = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+
+         if (got <= 0 || len + got >= sizeof(request) - 1) {
+            close(fd);
+            return NULL;
+         }
+
+         len += got;
+         request[len] = '\0';
+      }
+
+      if (sscanf(request, "%7s %1023s", method, path) != 2) {
+         break;
+      }
+
+      pthread_mutex_lock(&server_lock);
+      requests++;
+      gen = generation;
+      fail = inject && (int)(rand_r(&seed) % 100) < failure_rate;
+      pthread_mutex_unlock(&server_lock);
+
+      if (latency_ms > 0) {
+         sleep_for(latency_ms / 1000.0);
+      }
+
+      if (strncmp(path, "/repos/", 7) == 0 && strstr(path, "/releases/latest")) {
+         ok = serve_release(fd, request, gen, fail);
+      } else if (strstr(path, "/releases/download/") && !strstr(path, ".zsync")) {
+         ok = serve_asset(fd, request, strcmp(method, "HEAD") == 0, fail);
+      } else {
+         ok = respond(fd, "404 Not Found", "", NULL, 0, 0, false);
+      }
+
+      request[0] = '\0';
+
+      if (!ok) {
+         break;
+      }
+   }
+
+   close(fd);
+   return NULL;
+}
+
+static void *serve(void *arg)
+{
+   int listener = (int)(intptr_t)arg;
+
+   for (;;) {
+      int fd = accept(listener, NULL, NULL);
+      pthread_t thread;
+
+      if (fd < 0) {
+         continue;
+      }
+
+      if (pthread_create(&thread, NULL, serve_connection, (void *)(intptr_t)fd) == 0) {
+         pthread_detach(thread);
+      } else {
+         close(fd);
+      }
+   }
+   return NULL;
+}
+
+/**
+ * Listen on an ephemeral loopback port, or with listen false, find one
+ * that refuses connections.
+ */
+static int open_port(bool listening, int *port)
+{
+   struct sockaddr_in addr = { .sin_family = AF_INET };
+   socklen_t addr_len = sizeof(addr);
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+         || getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0 || (listening && listen(fd, 64) != 0)) {
+      perror("socket");
+      return -1;
+   }
+
+   *port = ntohs(addr.sin_port);
+
+   if (!listening) {
+      close(fd);
+   }
+   return fd;
+}
+
+static void core_log(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list va;
+
+   if (!verbose) {
+      return;
+   }
+
+   va_start(va, fmt);
+   vfprintf(stderr, fmt, va);
+   va_end(va);
+}
+
+/**
+ * Core options not listed keep their defaults.
+ */
+static const char *option(const char *name)
+{
+   static const char *const fixed[][2] = {
+      { "update_mode", "blocking" },
+      { "session_mode", "blocking" },
+      { "content_prefetch", "off" },
+      { "cpu_placement", "off" },
+      { "resource_groups", "disabled" },
+   };
+
+   if (strcmp(name, "cache_ttl") == 0) {
+      return cache_ttl;
+   }
+
+   for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) {
+      if (strcmp(name, fixed[i][0]) == 0) {
+         return fixed[i][1];
+      }
+   }
+   return NULL;
+}
+
+static bool environment(unsigned cmd, void *data)
+{
+   switch (cmd) {
+   case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+      ((struct retro_log_callback *)data)->log = core_log;
+      return true;
+   case RETRO_ENVIRONMENT_GET_VARIABLE: {
+      struct retro_variable *var = data;
+      const char *name = strstr(var->key, "_launcher_");
+
+      var->value = name ? option(name + strlen("_launcher_")) : NULL;
+      return var->value != NULL;
+   }
+   case RETRO_ENVIRONMENT_SET_VARIABLES:
+   case RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME:
+   case RETRO_ENVIRONMENT_SHUTDOWN:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static void video_refresh(const void *data, unsigned width, unsigned height, size_t pitch) {}
+static void audio_sample(int16_t left, int16_t right) {}
+static size_t audio_sample_batch(const int16_t *data, size_t frames) { return frames; }
+static void input_poll(void) {}
+static int16_t input_state(unsigned port, unsigned device, unsigned index, unsigned id) { return 0; }
+
+static bool load_core(const char *path, struct core_api *api)
+{
+   void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+   if (!lib) {
+      fprintf(stderr, "%s\n", dlerror());
+      return false;
+   }
+
+#define SYMBOL(field, name) if (!(*(void **)&api->field = dlsym(lib, name))) { \
+      fprintf(stderr, "%s: no %s\n", path, name); \
+      return false; \
+   }
+   SYMBOL(set_environment, "retro_set_environment");
+   SYMBOL(set_video_refresh, "retro_set_video_refresh");
+   SYMBOL(set_audio_sample, "retro_set_audio_sample");
+   SYMBOL(set_audio_sample_batch, "retro_set_audio_sample_batch");
+   SYMBOL(set_input_poll, "retro_set_input_poll");
+   SYMBOL(set_input_state, "retro_set_input_state");
+   SYMBOL(init, "retro_init");
+   SYMBOL(deinit, "retro_deinit");
+   SYMBOL(run, "retro_run");
+   SYMBOL(load_game, "retro_load_game");
+   SYMBOL(unload_game, "retro_unload_game");
+#undef SYMBOL
+   return true;
+}
+
+/**
+ * One launch the way RetroArch does it, returns the seconds spent in
+ * retro_load_game() and in ok whether it succeeded.
+ */
+static double launch(const struct core_api *api, bool *ok)
+{
+   double start, elapsed;
+
+   api->set_environment(environment);
+   api->set_video_refresh(video_refresh);
+   api->set_audio_sample(audio_sample);
+   api->set_audio_sample_batch(audio_sample_batch);
+   api->set_input_poll(input_poll);
+   api->set_input_state(input_state);
+   api->init();
+
+   start = now();
+   *ok = api->load_game(NULL);
+   elapsed = now() - start;
+
+   // The emulator has exited by now, the first frame shuts the core down.
+   if (*ok) {
+      api->run();
+      api->unload_game();
+   }
+
+   api->deinit();
+   return elapsed;
+}
+
+static bool installed(const char *home)
+{
+   char path[1200];
+   struct stat st;
+
+   snprintf(path, sizeof(path), "%s/.config/retroarch/system/%s/current", home, release->core);
+   return stat(path, &st) == 0;
+}
+
+static void fresh_home(const char *home)
+{
+   char path[1200];
+
+   remove_tree(home);
+   mkdir(home, 0755);
+   snprintf(path, sizeof(path), "%s/.config", home);
+   mkdir(path, 0755);
+   snprintf(path, sizeof(path), "%s/.config/retroarch", home);
+   mkdir(path, 0755);
+   snprintf(path, sizeof(path), "%s/.config/retroarch/system", home);
+   mkdir(path, 0755);
+   snprintf(path, sizeof(path), "%s/.config/retroarch/thumbnails", home);
+   mkdir(path, 0755);
+}
+
+/**
+ * Wine and its tools for xenia_canary, which only need to succeed.
+ */
+static void stub_tools(const char *bin)
+{
+   static const char *const tools[] = { "winetricks", "wineserver" };
+   char path[1200], *search;
+
+   mkdir(bin, 0755);
+   snprintf(path, sizeof(path), "%s/wine", bin);
+   write_file(path, "#!/bin/sh\n[ \"$1\" = --version ] && echo wine-9.0-bench\nexit 0\n", 0755);
+   snprintf(path, sizeof(path), "%s/wineboot", bin);
+   write_file(path, "#!/bin/sh\nmkdir -p \"$WINEPREFIX\"\n", 0755);
+
+   for (size_t i = 0; i < sizeof(tools) / sizeof(tools[0]); i++) {
+      snprintf(path, sizeof(path), "%s/%s", bin, tools[i]);
+      write_file(path, "#!/bin/sh\nexit 0\n", 0755);
+   }
+
+   if (asprintf(&search, "%s:%s", bin, getenv("PATH") ? getenv("PATH") : "/usr/bin:/bin") > 0) {
+      setenv("PATH", search, 1);
+      free(search);
+   }
+}
+
+static int compare(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+
+   return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int count, int p)
+{
+   int rank = (p * count + 99) / 100;
+
+   return sorted[rank > 0 ? rank - 1 : 0] * 1000;
+}
+
+/**
+ * Run a scenario and print its line, returns the number of failed launches.
+ */
+static int bench(const struct scenario *s, const struct core_api *api, const char *home, const char *url,
+      const char *offline_url, int runs)
+{
+   double times[MAX_RUNS];
+   int ok = 0;
+
+   setenv("LAUNCHER_GITHUB_URL", s->offline ? offline_url : url, 1);
+   cache_ttl = s->cache_ttl;
+
+   pthread_mutex_lock(&server_lock);
+   requests = 0;
+   served = 0;
+   pthread_mutex_unlock(&server_lock);
+
+   for (int i = 0; i < runs; i++) {
+      double elapsed;
+      bool loaded;
+
+      if (s->fresh_home) {
+         fresh_home(home);
+      }
+
+      if (s->new_release) {
+         pthread_mutex_lock(&server_lock);
+         generation++;
+         pthread_mutex_unlock(&server_lock);
+      }
+
+      elapsed = launch(api, &loaded);
+
+      // The first launch of a launcher only installs the emulator and fails the load.
+      if (s->fresh_home ? installed(home) : loaded) {
+         times[ok++] = elapsed;
+      }
+   }
+
+   printf("%-14s %4d/%-4d", s->name, ok, runs);
+
+   if (ok > 0) {
+      qsort(times, ok, sizeof(times[0]), compare);
+      printf(" %9.1f %9.1f %9.1f %9.1f %9.1f", times[0] * 1000, percentile(times, ok, 50),
+            percentile(times, ok, 90), percentile(times, ok, 99), times[ok - 1] * 1000);
+   } else {
+      printf(" %9s %9s %9s %9s %9s", "-", "-", "-", "-", "-");
+   }
+
+   printf(" %9ld %9.1f\n", requests, served / 1048576.0);
+   fflush(stdout);
+   return runs - ok;
+}
+
+static void usage(const char *name)
+{
+   fprintf(stderr,
+         "Usage: %s [-n runs] [-s MB] [-l ms] [-b MB/s] [-f percent] [-v] <core>_launcher_libretro.so\n"
+         "  -n  launches per scenario (default 10)\n"
+         "  -s  size of the release asset in MB (default 4)\n"
+         "  -l  latency added to every request in ms (default 0)\n"
+         "  -b  bandwidth of the server in MB/s (default unlimited)\n"
+         "  -f  percent of requests that fail, the API with HTTP 503, downloads halfway (default 0)\n"
+         "  -v  show the log of the core\n", name);
+}
+
+int main(int argc, char **argv)
+{
+   char base[] = "/tmp/launch-bench-XXXXXX", home[64], bin[64], url[64], offline_url[64], core[64];
+   const char *file;
+   double size = 4;
+   int runs = 10, opt, listener, port, closed_port, failed = 0;
+   struct core_api api;
+   pthread_t thread;
+
+   while ((opt = getopt(argc, argv, "n:s:l:b:f:vh")) != -1) {
+      switch (opt) {
+      case 'n':
+         runs = atoi(optarg);
+         break;
+      case 's':
+         size = atof(optarg);
+         break;
+      case 'l':
+         latency_ms = atoi(optarg);
+         break;
+      case 'b':
+         bandwidth = atof(optarg) * 1048576;
+         break;
+      case 'f':
+         failure_rate = atoi(optarg);
+         break;
+      case 'v':
+         verbose = true;
+         break;
+      default:
+         usage(argv[0]);
+         return opt == 'h' ? 0 : 2;
+      }
+   }
+
+   if (optind != argc - 1) {
+      usage(argv[0]);
+      return 2;
+   }
+
+   runs = runs < 1 ? 1 : runs > MAX_RUNS ? MAX_RUNS : runs;
+   size = size < 0.001 ? 0.001 : size;
+
+   // The core name is the file name up to "_launcher".
+   file = strrchr(argv[optind], '/') ? strrchr(argv[optind], '/') + 1 : argv[optind];
+   snprintf(core, sizeof(core), "%.*s", (int)(strstr(file, "_launcher") ? strstr(file, "_launcher") - file : 0), file);
+
+   for (size_t i = 0; i < sizeof(releases) / sizeof(releases[0]); i++) {
+      if (strcmp(releases[i].core, core) == 0) {
+         release = &releases[i];
+      }
+   }
+
+   if (!release) {
+      fprintf(stderr, "%s: not a known launcher core\n", file);
+      return 2;
+   }
+
+   if (!load_core(argv[optind], &api) || !make_asset((size_t)(size * 1048576))) {
+      return 1;
+   }
+
+   if ((listener = open_port(true, &port)) < 0 || open_port(false, &closed_port) < 0 || !mkdtemp(base)) {
+      return 1;
+   }
+
+   signal(SIGPIPE, SIG_IGN);
+   pthread_create(&thread, NULL, serve, (void *)(intptr_t)listener);
+   pthread_detach(thread);
+
+   snprintf(home, sizeof(home), "%s/home", base);
+   snprintf(bin, sizeof(bin), "%s/bin", base);
+   snprintf(url, sizeof(url), "http://127.0.0.1:%d", port);
+   snprintf(offline_url, sizeof(offline_url), "http://127.0.0.1:%d", closed_port);
+   setenv("HOME", home, 1);
+   stub_tools(bin);
+
+   printf("%s: %d launches per scenario, %.1f MB asset, latency %d ms, ", file, runs, asset_size / 1048576.0, latency_ms);
+
+   if (bandwidth > 0) {
+      printf("%.1f MB/s, ", bandwidth / 1048576);
+   } else {
+      printf("unlimited bandwidth, ");
+   }
+
+   printf("%d%% failed requests\n", failure_rate);
+   printf("%-14s %9s %9s %9s %9s %9s %9s %9s %9s\n", "scenario", "ok", "min ms", "p50 ms", "p90 ms", "p99 ms",
+         "max ms", "requests", "MB");
+
+   for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+      const struct scenario *s = &scenarios[i];
+      int failures;
+      bool loaded;
+
+      // Later scenarios start from an installed emulator, whatever the failures before.
+      if (!s->fresh_home) {
+         pthread_mutex_lock(&server_lock);
+         inject = false;
+         pthread_mutex_unlock(&server_lock);
+         setenv("LAUNCHER_GITHUB_URL", url, 1);
+         cache_ttl = "every launch";
+         launch(&api, &loaded);
+         pthread_mutex_lock(&server_lock);
+         inject = true;
+         pthread_mutex_unlock(&server_lock);
+      }
+
+      failures = bench(s, &api, home, url, offline_url, runs);
+
+      // Injected failures may fail a launch, except one that needs no server.
+      if (failures > 0 && (failure_rate == 0 || s->offline)) {
+         failed++;
+      }
+   }
+
+   remove_tree(base);
+   return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+/**
+ * update-all: check every emulator registered in the launcher metadata
+ * cache for a new release and stage it, with a bounded pool of worker
+ * threads sharing one pool of HTTP connections.
+ *
+ * Staged releases are installed by the launchers on their next start, so
+ * running it at boot or from a timer keeps every launch path warm.
+ * A launcher registers its core the first time it runs.
+ *
+ * With -r the named cores are rolled back to the version installed before
+ * the current one instead, which later updates then skip.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "cache.h"
+#include "http.h"
+#include "mirror.h"
+#include "update.h"
+#include "log.h"
+
+#define MAX_CORES 32
+#define MAX_WORKERS 16
+#define CACHE_FILE "/.config/retroarch/system/launcher.cache"
+
+struct core_job {
+   char core[32];
+   struct cache_entry entry;
+   struct install_layout layout;
+   enum update_result result;
+   double seconds;
+};
+
+static struct core_job jobs[MAX_CORES];
+static size_t job_count;
+static size_t next_job;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static char cache_path[1024];
+static char mirror_path[1100];
+static long ttl;
+
+static void usage(const char *name)
+{
+   fprintf(stderr,
+         "Usage: %s [-j workers] [-c connections] [-s segment MB] [-t seconds] [-k versions] [-b budget GB]\n"
+         "          [-f cache] [-m mirror] [core...]\n"
+         "       %s -r [-f cache] core...\n"
+         "  -j  cores updated at the same time (default 4)\n"
+         "  -c  connections per download (default 4)\n"
+         "  -s  size of the range requests of large downloads (default 8)\n"
+         "  -t  skip cores checked less than this many seconds ago (default 0)\n"
+         "  -k  previous versions kept per core (default 1)\n"
+         "  -b  disk budget per core in GB, 0 for no limit (default 0)\n"
+         "  -f  metadata cache (default $HOME" CACHE_FILE ")\n"
+         "  -m  release mirror file (default launcher.mirror next to the cache)\n"
+         "  -r  roll the named cores back to their previous version\n", name, name);
+}
+
+static void interrupt(int sig)
+{
+   // Unfinished downloads keep their .part files and resume on the next run.
+   http_cancel(true);
+}
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct core_job *take_job(void)
+{
+   struct core_job *job = NULL;
+
+   pthread_mutex_lock(&job_lock);
+   if (next_job < job_count) {
+      job = &jobs[next_job++];
+   }
+   pthread_mutex_unlock(&job_lock);
+   return job;
+}
+
+static void *worker(void *arg)
+{
+   struct core_job *job;
+
+   (void)arg;
+
+   while ((job = take_job()) != NULL) {
+      char *urls[] = { job->entry.api_url, job->entry.download_url };
+      double start = now();
+
+      job->result = update_stage(cache_path, job->core, urls, job->entry.asset, ttl,
+            job->entry.path, &job->layout);
+      job->seconds = now() - start;
+   }
+   return NULL;
+}
+
+static bool selected(const char *core, char **names, int count)
+{
+   for (int i = 0; i < count; i++) {
+      if (strcmp(core, names[i]) == 0) {
+         return true;
+      }
+   }
+   return count == 0;
+}
+
+/**
+ * Queue the registered and installed cores of the cache, or only the ones
+ * named on the command line.
+ */
+static void queue_cores(char **names, int count)
+{
+   char cores[MAX_CORES][32];
+   size_t found = cache_list(cache_path, cores, MAX_CORES);
+
+   for (size_t i = 0; i < found; i++) {
+      struct core_job *job = &jobs[job_count];
+
+      if (!selected(cores[i], names, count)) {
+         continue;
+      }
+
+      cache_load(cache_path, cores[i], &job->entry);
+
+      if (job->entry.api_url[0] == '\0' || job->entry.path[0] == '\0') {
+         fprintf(stderr, "%s: not registered yet, launch it once first.\n", cores[i]);
+         continue;
+      }
+      if (job->entry.current[0] == '\0') {
+         fprintf(stderr, "%s: not installed, skipped.\n", cores[i]);
+         continue;
+      }
+      if (!update_layout(&job->entry, &job->layout)) {
+         fprintf(stderr, "%s: unknown release layout, launch it once first.\n", cores[i]);
+         continue;
+      }
+
+      snprintf(job->core, sizeof(job->core), "%s", cores[i]);
+      job_count++;
+   }
+}
+
+int main(int argc, char **argv)
+{
+   static const char *results[] = { "failed", "current", "staged" };
+   pthread_t threads[MAX_WORKERS];
+   int workers = 4, connections = 4, segment_size = 8, keep = 1, budget = 0, opt;
+   bool rollback = false;
+   size_t started = 0, failed = 0;
+   double start = now();
+
+   while ((opt = getopt(argc, argv, "j:c:s:t:k:b:f:m:rh")) != -1) {
+      switch (opt) {
+      case 'j':
+         workers = atoi(optarg);
+         break;
+      case 'c':
+         connections = atoi(optarg);
+         break;
+      case 's':
+         segment_size = atoi(optarg);
+         break;
+      case 't':
+         ttl = atol(optarg);
+         break;
+      case 'k':
+         keep = atoi(optarg);
+         break;
+      case 'b':
+         budget = atoi(optarg);
+         break;
+      case 'r':
+         rollback = true;
+         break;
+      case 'f':
+         snprintf(cache_path, sizeof(cache_path), "%s", optarg);
+         break;
+      case 'm':
+         snprintf(mirror_path, sizeof(mirror_path), "%s", optarg);
+         break;
+      default:
+         usage(argv[0]);
+         return opt == 'h' ? 0 : 2;
+      }
+   }
+
+   if (cache_path[0] == '\0') {
+      const char *home = getenv("HOME");
+
+      snprintf(cache_path, sizeof(cache_path), "%s%s", home ? home : "", CACHE_FILE);
+   }
+
+   if (mirror_path[0] == '\0') {
+      const char *slash = strrchr(cache_path, '/');
+
+      snprintf(mirror_path, sizeof(mirror_path), "%.*slauncher.mirror", slash ? (int)(slash - cache_path + 1) : 0,
+            cache_path);
+   }
+
+   // Rollback activates a kept version, nothing is downloaded.
+   if (rollback) {
+      int status = 0;
+
+      if (optind == argc) {
+         usage(argv[0]);
+         return 2;
+      }
+      for (int i = optind; i < argc; i++) {
+         if (update_rollback(cache_path, argv[i])) {
+            printf("%-16s rolled back\n", argv[i]);
+         } else {
+            status = 1;
+         }
+      }
+      return status;
+   }
+
+   workers = workers < 1 ? 1 : workers > MAX_WORKERS ? MAX_WORKERS : workers;
+   queue_cores(argv + optind, argc - optind);
+
+   if (job_count == 0) {
+      fprintf(stderr, "No emulators to update in %s\n", cache_path);
+      return 0;
+   }
+
+   signal(SIGINT, interrupt);
+   signal(SIGTERM, interrupt);
+
+   if (!http_init() || !http_share_connections()) {
+      fprintf(stderr, "Cannot initialize libcurl\n");
+      return 1;
+   }
+   http_set_connections(connections, segment_size * 1048576LL);
+   mirror_load(mirror_path);
+   install_set_limits(keep, budget * 1073741824LL);
+
+   for (int i = 0; i < workers && (size_t)i < job_count; i++) {
+      if (pthread_create(&threads[started], NULL, worker, NULL) == 0) {
+         started++;
+      }
+   }
+
+   // Without any thread the jobs still run, one by one.
+   if (started == 0) {
+      worker(NULL);
+   }
+
+   for (size_t i = 0; i < started; i++) {
+      pthread_join(threads[i], NULL);
+   }
+
+   for (size_t i = 0; i < job_count; i++) {
+      printf("%-16s %-8s %6.1fs\n", jobs[i].core, results[jobs[i].result], jobs[i].seconds);
+      failed += jobs[i].result == UPDATE_FAILED;
+   }
+   printf("%zu emulators checked in %.1fs, %zu failed\n", job_count, now() - start, failed);
+
+   http_deinit();
+   return failed > 0 ? 1 : 0;
+}